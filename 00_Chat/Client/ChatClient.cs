@@ -375,6 +375,40 @@ internal class ChatClient : IAsyncDisposable, IDisposable
                 }
             }
 
+            // If the user requested to join or leave a room
+            else if (split.Length > 0 && (split[0] == "/join" || split[0] == "/leave"))
+            {
+                if (split.Length < 2)
+                {
+                    Console.WriteLine($"You should provide a room name after {split[0]}");
+                    continue;
+                }
+                else
+                {
+                    string room = string.Join(' ', split[1..]);
+                    msg = (split[0] == "/join")
+                        ? new() { JoinRoom = new() { Room = room } }
+                        : new() { LeaveRoom = new() { Room = room } };
+                }
+            }
+
+            // If the user typed a chat message to a room, as `/room <room> <message>`
+            else if (split.Length > 0 && split[0] == "/room")
+            {
+                if (split.Length < 3)
+                {
+                    Console.WriteLine("You should provide a room name and a message after /room");
+                    continue;
+                }
+                else
+                {
+                    msg = new()
+                    {
+                        Chat = new() { Room = split[1], Content = string.Join(' ', split[2..]) },
+                    };
+                }
+            }
+
             // If the user typed a chat message
             else
             {
@@ -399,6 +433,22 @@ internal class ChatClient : IAsyncDisposable, IDisposable
         Console.WriteLine("Quited!");
     }
 
+    /// <summary>
+    /// Print the chat message, with its room if it was sent to a room.
+    /// </summary>
+    /// <param name="chat">The chat message.</param>
+    private static void PrintChat(Chat chat)
+    {
+        if (string.IsNullOrEmpty(chat.Room))
+        {
+            Console.WriteLine($"{chat.SenderName ?? "???"}: {chat.Content ?? string.Empty}");
+        }
+        else
+        {
+            Console.WriteLine($"[{chat.Room}] {chat.SenderName ?? "???"}: {chat.Content ?? string.Empty}");
+        }
+    }
+
     /// <summary>
     /// Receive data and run callbacks here.
     /// </summary>
@@ -497,7 +547,16 @@ internal class ChatClient : IAsyncDisposable, IDisposable
         {
             case ChatProtocol.MsgOneofCase.Chat:
                 // Print the chat message
-                Console.WriteLine($"{msg.Chat.SenderName ?? "???"}: {msg.Chat.Content ?? string.Empty}");
+                PrintChat(msg.Chat);
+                break;
+
+            case ChatProtocol.MsgOneofCase.ChatBatch:
+                // Print the chat messages coalesced by the server
+                foreach (Chat chat in msg.ChatBatch.Chats)
+                {
+                    PrintChat(chat);
+                }
+
                 break;
 
             default:
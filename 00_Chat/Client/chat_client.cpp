@@ -1,8 +1,792 @@
 // SPDX-License-Identifier: 0BSD
 
+#include "../Proto/ChatProtocol.pb.h"
+
+#include "../STServer/cli_args.hpp"
+#include "../STServer/metrics.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief Reads the lines from the stdin on its own thread, so the client loop never blocks on the console.
+///
+/// The reader thread is detached, as it might be blocked on the stdin forever;
+/// it shares the state with this only through a `std::shared_ptr`, so it can outlive this.
+class console_input
+{
+private:
+    struct state
+    {
+        std::mutex mutex;
+        std::vector<std::string> lines;
+        bool closed = false;
+    };
+
+private:
+    std::shared_ptr<state> _state = std::make_shared<state>();
+
+public:
+    console_input()
+    {
+        std::thread([state = _state] {
+            std::string line;
+            while (std::getline(std::cin, line))
+            {
+                std::lock_guard lock(state->mutex);
+                state->lines.push_back(std::move(line));
+            }
+
+            std::lock_guard lock(state->mutex);
+            state->closed = true;
+        }).detach();
+    }
 
-int main()
+    /// @brief Take the lines read so far, without blocking.
+    /// @param lines Cleared, and filled with the lines.
+    /// @return Whether the stdin is still open.
+    bool take_lines(std::vector<std::string>& lines)
+    {
+        lines.clear();
+
+        std::lock_guard lock(_state->mutex);
+        std::swap(lines, _state->lines);
+        return !_state->closed;
+    }
+};
+
+class chat_client
 {
-    std::cout << "C++ chat_client not implemented yet :(" << std::endl;
+public:
+    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
+    static constexpr int MAX_MESSAGES_PER_RECEIVE = 100;
+
+    /// @brief Upper bound of a single blocking wait on the sockets.
+    /// The client loop wakes up as soon as something arrives, so this only matters when idle.
+    static constexpr int MAX_POLL_WAIT_MILLISECONDS = 100;
+
+    /// @brief Upper bound of a wait on the sockets when reading from the console,
+    /// as a line typed in doesn't wake up the wait.
+    static constexpr int CONSOLE_POLL_WAIT_MILLISECONDS = 10;
+
+    /// @brief How long to wait for the echoes of the probes, after the last one is sent.
+    static constexpr SteamNetworkingMicroseconds PROBE_ECHO_TIMEOUT_USEC = 2'000'000;
+
+    /// @brief Runtime settings of the client.
+    struct settings
+    {
+        /// @brief Whether to send probe chats and report their round-trip latency, instead of reading the console.
+        ///
+        /// As the server doesn't relay a chat back to its sender, the client opens a second connection,
+        /// which the server relays the probes to.
+        /// The round-trip is from sending a probe on the first connection until receiving it on the second one.
+        bool headless = false;
+
+        /// @brief Probes per second.
+        /// Keep this under the chat rate limit of the server, or the server drops some of them.
+        double probe_rate = 5;
+
+        /// @brief Stop after sending this many probes; zero for no limit.
+        std::uint64_t probe_count = 0;
+
+        /// @brief Stop after sending the probes for this long; zero for no limit.
+        std::chrono::seconds probe_duration{0};
+
+        /// @brief Content length of a probe, padded if it's longer than the probe header.
+        std::size_t probe_size = 32;
+
+        /// @brief How often the round-trip latency is reported.
+        std::chrono::seconds report_interval{1};
+    };
+
+private:
+    bool _disposed = true;
+
+    bool _gns_initialized = false;
+
+    settings _settings;
+
+    HSteamNetPollGroup _poll_group = k_HSteamNetPollGroup_Invalid;
+    HSteamNetConnection _conn = k_HSteamNetConnection_Invalid;
+    // Receives the probes sent from `_conn`, in the headless mode.
+    HSteamNetConnection _echo_conn = k_HSteamNetConnection_Invalid;
+    int _connected_count = 0;
+
+    bool _quit_requested = false;
+
+    std::unique_ptr<console_input> _console;
+    std::vector<std::string> _console_lines;
+
+    std::vector<SteamNetworkingMessage_t*> _received_msgs;
+
+    // Reused for every message, to avoid allocating on each one
+    GNSPrac::Chat::ChatProtocol _received;
+    GNSPrac::Chat::ChatProtocol _outgoing;
+    std::string _send_buffer;
+
+    // Probes of the headless mode, tagged with a nonce so the ones from other clients are told apart
+    std::uint64_t _probe_nonce = 0;
+    std::uint64_t _probes_sent = 0;
+    std::uint64_t _probes_echoed = 0;
+    std::unordered_map<std::uint64_t, SteamNetworkingMicroseconds> _probe_send_times;
+    SteamNetworkingMicroseconds _next_probe_time = 0;
+    SteamNetworkingMicroseconds _probe_end_time = 0;
+    SteamNetworkingMicroseconds _last_probe_time = 0;
+    SteamNetworkingMicroseconds _next_report_time = 0;
+    bool _probes_done = false;
+    histogram _rtt_us;
+    histogram _interval_rtt_us;
+
+public:
+    chat_client() = default;
+
+    // Callbacks are routed to this client by its address
+    chat_client(const chat_client&) = delete;
+    chat_client& operator=(const chat_client&) = delete;
+
+    ~chat_client()
+    {
+        dispose();
+    }
+
+public:
+    /// @brief Connect to the server with specified address.
+    /// @param addr Address of the server.
+    /// @param client_settings Runtime settings of the client.
+    /// @return Whether the connection has been requested, or errored.
+    /// Note that returning `true` means the request succeeded, not connected.
+    bool connect(const SteamNetworkingIPAddr& addr, const settings& client_settings)
+    {
+        // Prevent connecting twice
+        if (!_disposed)
+            return false;
+
+        _disposed = false;
+
+        try
+        {
+            _settings = client_settings;
+            _received_msgs.resize(MAX_MESSAGES_PER_RECEIVE);
+
+            // Service the sockets from the client loop, instead of the GNS's internal service thread,
+            // so the client loop blocks until something actually arrives.
+            // Note that this must be set before initializing `GameNetworkingSockets`.
+            SteamNetworkingSockets_SetManualPollMode(true);
+
+            // Initialize `GameNetworkingSockets`
+            SteamDatagramErrMsg err_msg;
+            if (!GameNetworkingSockets_Init(nullptr, err_msg))
+                throw std::runtime_error(err_msg);
+            _gns_initialized = true;
+
+            SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Warning,
+                                                           on_gns_debug_output);
+
+            // Receive from all the connections at once
+            _poll_group = SteamNetworkingSockets()->CreatePollGroup();
+
+            _conn = connect_to(addr);
+            if (_settings.headless)
+            {
+                _echo_conn = connect_to(addr);
+
+                _probe_nonce = std::random_device{}();
+                _probe_nonce = (_probe_nonce << 32) | std::random_device{}();
+                _probes_sent = 0;
+                _probes_echoed = 0;
+                _probes_done = false;
+                _probe_send_times.clear();
+                _rtt_us.reset();
+                _interval_rtt_us.reset();
+            }
+            else
+            {
+                _console = std::make_unique<console_input>();
+            }
+
+            _connected_count = 0;
+            _quit_requested = false;
+        }
+        catch (const std::exception& ex)
+        {
+            std::cout << "Failed to connect to server: " << ex.what() << std::endl;
+
+            dispose();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Run the client loop, until the user quits, the probes are done, or the connection is closed.
+    void run()
+    {
+        while (!_quit_requested)
+        {
+            // Block until the sockets have something for us, or a GNS timer is due
+            SteamNetworkingSockets_Poll(poll_wait_milliseconds());
+
+            // Callbacks are run only here, so they're on this thread
+            SteamNetworkingSockets()->RunCallbacks();
+
+            receive_messages();
+
+            if (_settings.headless)
+                run_probes();
+            else
+                handle_console_input();
+        }
+    }
+
+    /// @brief Stop the client.
+    /// @param linger_milliseconds Milliseconds to wait before dropping the connections.
+    /// This can be useful if you want to send a goodbye message or similar.
+    void stop(int linger_milliseconds = 0)
+    {
+        if (_disposed)
+            return;
+
+        std::cout << "Closing the connection..." << std::endl;
+
+        // Close the connections with linger enabled
+        for (const auto conn : {_conn, _echo_conn})
+            if (conn != k_HSteamNetConnection_Invalid)
+                SteamNetworkingSockets()->CloseConnection(conn, 0, "Client quit", true);
+        _conn = k_HSteamNetConnection_Invalid;
+        _echo_conn = k_HSteamNetConnection_Invalid;
+
+        // As we're on the manual poll mode, nobody services the sockets unless someone polls them,
+        // so just sleeping would never flush the lingering connections.
+        const auto linger_end = std::chrono::steady_clock::now() + std::chrono::milliseconds(linger_milliseconds);
+        for (auto now = std::chrono::steady_clock::now(); now < linger_end; now = std::chrono::steady_clock::now())
+        {
+            const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(linger_end - now).count();
+            SteamNetworkingSockets_Poll((int)std::min<long long>(remaining, MAX_POLL_WAIT_MILLISECONDS));
+        }
+
+        dispose();
+    }
+
+    /// @brief Disposes the client synchronously.
+    void dispose()
+    {
+        if (!_disposed)
+        {
+            if (_gns_initialized)
+            {
+                for (const auto conn : {_conn, _echo_conn})
+                    if (conn != k_HSteamNetConnection_Invalid)
+                        SteamNetworkingSockets()->CloseConnection(conn, 0, "Dispose", false);
+                _conn = k_HSteamNetConnection_Invalid;
+                _echo_conn = k_HSteamNetConnection_Invalid;
+
+                if (_poll_group != k_HSteamNetPollGroup_Invalid)
+                {
+                    SteamNetworkingSockets()->DestroyPollGroup(_poll_group);
+                    _poll_group = k_HSteamNetPollGroup_Invalid;
+                }
+
+                GameNetworkingSockets_Kill();
+                _gns_initialized = false;
+            }
+
+            _console.reset();
+
+            _disposed = true;
+        }
+    }
+
+    /// @brief Print the round-trip latency of all the probes, and the lost ones.
+    void print_probe_summary() const
+    {
+        const auto rtt = _rtt_us.get_summary();
+        std::cout << std::format("Probes sent: {}, echoed: {}, lost: {}", _probes_sent, _probes_echoed,
+                                 _probe_send_times.size())
+                  << std::endl;
+        std::cout << std::format("Round-trip latency: mean {:.1f}us, p50 {}us, p90 {}us, p99 {}us, p99.9 {}us, "
+                                 "max {}us",
+                                 rtt.mean, rtt.p50, rtt.p90, rtt.p99, rtt.p999, rtt.max)
+                  << std::endl;
+    }
+
+private:
+    auto connect_to(const SteamNetworkingIPAddr& addr) -> HSteamNetConnection
+    {
+        // Route the callbacks of this connection to this client, via the connection user data
+        SteamNetworkingConfigValue_t configs[2]{};
+        configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                          (void*)on_connection_status_changed);
+        configs[1].SetInt64(k_ESteamNetworkingConfig_ConnectionUserData, (int64)(std::intptr_t)this);
+
+        const HSteamNetConnection conn = SteamNetworkingSockets()->ConnectByIPAddress(addr, 2, configs);
+        if (conn == k_HSteamNetConnection_Invalid)
+            throw std::runtime_error("Failed to create a connection");
+
+        SteamNetworkingSockets()->SetConnectionPollGroup(conn, _poll_group);
+        return conn;
+    }
+
+    auto poll_wait_milliseconds() const -> int
+    {
+        if (!_settings.headless)
+            return CONSOLE_POLL_WAIT_MILLISECONDS;
+
+        if (_connected_count < 2)
+            return MAX_POLL_WAIT_MILLISECONDS;
+
+        // Don't wait past the next probe or report
+        const SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+        const SteamNetworkingMicroseconds next_event =
+            _probes_done ? _next_report_time : std::min(_next_probe_time, _next_report_time);
+        return (int)std::clamp<SteamNetworkingMicroseconds>((next_event - now) / 1000, 0, MAX_POLL_WAIT_MILLISECONDS);
+    }
+
+    static void on_gns_debug_output(ESteamNetworkingSocketsDebugOutputType, const char* msg)
+    {
+        std::cerr << "[GNS] " << msg << std::endl;
+    }
+
+    /// @brief Callback that's called from the GNS when connection status changed.
+    /// It's called on the client loop, within `RunCallbacks()`.
+    /// @param info Connection status changed info.
+    static void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
+    {
+        auto* client = reinterpret_cast<chat_client*>((std::intptr_t)info->m_info.m_nUserData);
+        if (client)
+            client->handle_status_change(*info);
+    }
+
+    void handle_status_change(const SteamNetConnectionStatusChangedCallback_t& info)
+    {
+        switch (info.m_info.m_eState)
+        {
+        case k_ESteamNetworkingConnectionState_None:
+            // This is when you destroy the connection.
+            // Nothing to do here.
+            break;
+
+        case k_ESteamNetworkingConnectionState_Connected:
+            ++_connected_count;
+            if (!_settings.headless)
+            {
+                std::cout << "Successfully connected to server!\nTo change your name, type /name <your new name>."
+                          << std::endl;
+            }
+            else if (_connected_count == 2)
+            {
+                std::cout << std::format("Connected, sending {} probes per second", _settings.probe_rate)
+                          << std::endl;
+
+                const SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+                _next_probe_time = now;
+                _next_report_time = now + std::chrono::microseconds(_settings.report_interval).count();
+                _probe_end_time = _settings.probe_duration.count() > 0
+                                      ? now + std::chrono::microseconds(_settings.probe_duration).count()
+                                      : 0;
+            }
+            break;
+
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally: {
+            // Print the reason of connection close
+            const SteamNetConnectionInfo_t& conn_info = info.m_info;
+            std::string_view state = conn_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
+                                         ? "closed by peer"
+                                         : "problem detected locally";
+            std::cout << std::format("{} ({}), reason {}: {}", conn_info.m_szConnectionDescription, state,
+                                     conn_info.m_eEndReason, conn_info.m_szEndDebug)
+                      << std::endl;
+
+            SteamNetworkingSockets()->CloseConnection(info.m_hConn, 0, nullptr, false);
+            if (info.m_hConn == _conn)
+                _conn = k_HSteamNetConnection_Invalid;
+            else if (info.m_hConn == _echo_conn)
+                _echo_conn = k_HSteamNetConnection_Invalid;
+
+            _quit_requested = true;
+            break;
+        }
+
+        default:
+            break;
+        }
+    }
+
+    void receive_messages()
+    {
+        while (true)
+        {
+            const int received_msg_count = SteamNetworkingSockets()->ReceiveMessagesOnPollGroup(
+                _poll_group, _received_msgs.data(), MAX_MESSAGES_PER_RECEIVE);
+            if (received_msg_count == -1)
+                throw std::runtime_error("receive msg failed");
+
+            for (int i = 0; i < received_msg_count; ++i)
+            {
+                on_message(*_received_msgs[i]);
+
+                _received_msgs[i]->Release();
+            }
+
+            if (received_msg_count < MAX_MESSAGES_PER_RECEIVE)
+                break;
+        }
+    }
+
+    /// @brief Handle a message from the server.
+    void on_message(const SteamNetworkingMessage_t& net_msg)
+    {
+        // Ignore the empty message.
+        // In this case, `net_msg.m_pData` is nullptr
+        if (net_msg.m_cbSize == 0)
+        {
+            std::cout << "Server sent an empty message" << std::endl;
+            return;
+        }
+
+        if (!_received.ParseFromArray(net_msg.m_pData, net_msg.m_cbSize))
+        {
+            std::cout << "Server sent an invalid message" << std::endl;
+            return;
+        }
+
+        // Handle the message based on its type
+        switch (_received.msg_case())
+        {
+        case GNSPrac::Chat::ChatProtocol::kChat:
+            on_chat(net_msg, _received.chat());
+            break;
+
+        case GNSPrac::Chat::ChatProtocol::kChatBatch:
+            // Chats coalesced by the server
+            for (const auto& chat : _received.chat_batch().chats())
+                on_chat(net_msg, chat);
+            break;
+
+        default:
+            // Server shouldn't send other type of messages
+            std::cout << "Server sent an invalid message type: " << (int)_received.msg_case() << std::endl;
+            break;
+        }
+    }
+
+    void on_chat(const SteamNetworkingMessage_t& net_msg, const GNSPrac::Chat::Chat& chat)
+    {
+        if (_settings.headless)
+        {
+            // Only the echo connection counts the probes, as the other one sees the same chats from the others
+            if (net_msg.m_conn == _echo_conn)
+                on_probe_echo(chat.content(), net_msg.m_usecTimeReceived);
+            return;
+        }
+
+        if (chat.room().empty())
+            std::cout << std::format("{}: {}", chat.sender_name(), chat.content()) << std::endl;
+        else
+            std::cout << std::format("[{}] {}: {}", chat.room(), chat.sender_name(), chat.content()) << std::endl;
+    }
+
+    /// @brief Send the lines typed in the console.
+    void handle_console_input()
+    {
+        if (!_console->take_lines(_console_lines))
+            _quit_requested = true;
+
+        for (const auto& line : _console_lines)
+        {
+            if (line.empty())
+                continue;
+
+            if (line == "/quit")
+            {
+                _quit_requested = true;
+                return;
+            }
+
+            const std::string_view message = line;
+            const auto space = message.find(' ');
+            const std::string_view command = message.substr(0, space);
+            const std::string_view argument = space == std::string_view::npos ? "" : message.substr(space + 1);
+
+            _outgoing.Clear();
+            if (command == "/name")
+            {
+                if (argument.empty())
+                {
+                    std::cout << "You should provide a new name after /name" << std::endl;
+                    continue;
+                }
+                _outgoing.mutable_name_change()->set_name(argument.data(), argument.size());
+            }
+            else if (command == "/join" || command == "/leave")
+            {
+                if (argument.empty())
+                {
+                    std::cout << "You should provide a room name after " << command << std::endl;
+                    continue;
+                }
+                if (command == "/join")
+                    _outgoing.mutable_join_room()->set_room(argument.data(), argument.size());
+                else
+                    _outgoing.mutable_leave_room()->set_room(argument.data(), argument.size());
+            }
+            else if (command == "/room")
+            {
+                // `/room <room> <message>`
+                const auto room_end = argument.find(' ');
+                if (argument.empty() || room_end == std::string_view::npos)
+                {
+                    std::cout << "You should provide a room name and a message after /room" << std::endl;
+                    continue;
+                }
+                auto& chat = *_outgoing.mutable_chat();
+                chat.set_room(argument.data(), room_end);
+                chat.set_content(argument.data() + room_end + 1, argument.size() - room_end - 1);
+            }
+            else
+            {
+                _outgoing.mutable_chat()->set_content(message.data(), message.size());
+            }
+
+            send(_conn, _outgoing);
+        }
+    }
+
+    void send(HSteamNetConnection conn, const GNSPrac::Chat::ChatProtocol& msg)
+    {
+        msg.SerializeToString(&_send_buffer);
+        SteamNetworkingSockets()->SendMessageToConnection(conn, _send_buffer.data(), (uint32)_send_buffer.size(),
+                                                          k_nSteamNetworkingSend_ReliableNoNagle, nullptr);
+    }
+
+    /// @brief Send the probes due by now, report the latency if it's time, and quit when the probes are done.
+    void run_probes()
+    {
+        if (_connected_count < 2)
+            return;
+
+        const SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+
+        _probes_done = (_settings.probe_count > 0 && _probes_sent >= _settings.probe_count) ||
+                       (_probe_end_time > 0 && now >= _probe_end_time);
+        if (!_probes_done)
+        {
+            // Catch up if the loop was late, but don't burst more than a second worth of probes
+            const auto probe_interval = (SteamNetworkingMicroseconds)(1'000'000 / _settings.probe_rate);
+            _next_probe_time = std::max(_next_probe_time, now - 1'000'000);
+            while (_next_probe_time <= now &&
+                   (_settings.probe_count == 0 || _probes_sent < _settings.probe_count))
+            {
+                send_probe(now);
+                _next_probe_time += probe_interval;
+            }
+        }
+
+        if (now >= _next_report_time)
+        {
+            print_probe_report();
+            _next_report_time = now + std::chrono::microseconds(_settings.report_interval).count();
+        }
+
+        // Quit when all the probes are echoed, or the rest are considered lost
+        if (_probes_done && (_probe_send_times.empty() || now - _last_probe_time >= PROBE_ECHO_TIMEOUT_USEC))
+            _quit_requested = true;
+    }
+
+    void send_probe(SteamNetworkingMicroseconds now)
+    {
+        const std::uint64_t seq = _probes_sent++;
+
+        // "rtt <nonce> <seq> ", padded up to the probe size
+        std::string content = std::format("rtt {:016x} {} ", _probe_nonce, seq);
+        if (content.size() < _settings.probe_size)
+            content.resize(_settings.probe_size, '.');
+
+        _outgoing.Clear();
+        *_outgoing.mutable_chat()->mutable_content() = std::move(content);
+        send(_conn, _outgoing);
+
+        _probe_send_times.emplace(seq, now);
+        _last_probe_time = now;
+    }
+
+    void on_probe_echo(std::string_view content, SteamNetworkingMicroseconds received_time)
+    {
+        // Parse "rtt <nonce> <seq> "
+        constexpr std::string_view prefix = "rtt ";
+        constexpr std::size_t nonce_length = 16;
+        if (!content.starts_with(prefix) || content.size() < prefix.size() + nonce_length + 1)
+            return;
+        content.remove_prefix(prefix.size());
+
+        std::uint64_t nonce;
+        if (std::from_chars(content.data(), content.data() + nonce_length, nonce, 16).ec != std::errc{} ||
+            nonce != _probe_nonce)
+            return;
+        content.remove_prefix(nonce_length + 1);
+
+        std::uint64_t seq;
+        if (std::from_chars(content.data(), content.data() + content.size(), seq).ec != std::errc{})
+            return;
+
+        const auto it = _probe_send_times.find(seq);
+        if (it == _probe_send_times.end())
+            return;
+
+        const auto rtt = (std::uint64_t)std::max<SteamNetworkingMicroseconds>(received_time - it->second, 0);
+        _probe_send_times.erase(it);
+        ++_probes_echoed;
+
+        _rtt_us.record(rtt);
+        _interval_rtt_us.record(rtt);
+    }
+
+    void print_probe_report()
+    {
+        const auto rtt = _interval_rtt_us.get_summary();
+        _interval_rtt_us.reset();
+
+        // Ping of the transport, to tell the time spent in the server from the time spent on the links
+        SteamNetConnectionRealTimeStatus_t status{};
+        SteamNetworkingSockets()->GetConnectionRealTimeStatus(_conn, &status, 0, nullptr);
+
+        std::cout << std::format("Sent: {}, echoed: {}, in flight: {}, round-trip p50/p90/p99/max: {}/{}/{}/{}us "
+                                 "(ping {}ms)",
+                                 _probes_sent, _probes_echoed, _probe_send_times.size(), rtt.p50, rtt.p90, rtt.p99,
+                                 rtt.max, status.m_nPing)
+                  << std::endl;
+    }
+};
+
+int main(int argc, char** args)
+{
+    std::cout << "GNS-Practice #00: Chat" << std::endl;
+    std::cout << "Chat client in C++ with GameNetworkingSockets\n" << std::endl;
+
+    // Parse the server address and options from `args`
+    // Usage: chat_client [host] [port] [--headless] [--rate=<probes per second>] [--count=<probes>]
+    //                    [--duration-s=<seconds>] [--size=<bytes>]
+    std::string_view host;
+    std::uint16_t port = chat_client::DEFAULT_SERVER_PORT;
+    int positional_count = 0;
+    chat_client::settings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = args[i];
+
+        if (arg == "--headless")
+        {
+            settings.headless = true;
+        }
+        else if (arg.starts_with("--rate="))
+        {
+            long rate;
+            if (!parse_long(arg.substr(arg.find('=') + 1), rate) || rate <= 0 || rate > 1'000'000)
+            {
+                std::cout << "Invalid probe rate: " << arg << std::endl;
+                return 0;
+            }
+            settings.probe_rate = (double)rate;
+        }
+        else if (arg.starts_with("--count="))
+        {
+            long count;
+            if (!parse_long(arg.substr(arg.find('=') + 1), count) || count < 0)
+            {
+                std::cout << "Invalid probe count: " << arg << std::endl;
+                return 0;
+            }
+            settings.probe_count = (std::uint64_t)count;
+        }
+        else if (arg.starts_with("--duration-s="))
+        {
+            long duration;
+            if (!parse_long(arg.substr(arg.find('=') + 1), duration) || duration < 0)
+            {
+                std::cout << "Invalid probe duration: " << arg << std::endl;
+                return 0;
+            }
+            settings.probe_duration = std::chrono::seconds(duration);
+        }
+        else if (arg.starts_with("--size="))
+        {
+            long size;
+            if (!parse_long(arg.substr(arg.find('=') + 1), size) || size < 0 || size > 512 * 1024)
+            {
+                std::cout << "Invalid probe size: " << arg << std::endl;
+                return 0;
+            }
+            settings.probe_size = (std::size_t)size;
+        }
+        else if (positional_count++ == 0)
+        {
+            host = arg;
+        }
+        else
+        {
+            long parsed_port;
+            if (!parse_long(arg, parsed_port) || parsed_port < 0 || parsed_port >= 65536)
+            {
+                std::cout << "Invalid port: " << arg << std::endl;
+                return 0;
+            }
+            port = (std::uint16_t)parsed_port;
+        }
+    }
+
+    // Setup the address; only numeric addresses are supported, and an empty one is the local host
+    SteamNetworkingIPAddr addr{};
+    if (host.empty() || host == "localhost")
+    {
+        addr.SetIPv6LocalHost(port);
+    }
+    else if (!addr.ParseString(std::string(host).c_str()))
+    {
+        std::cout << "Invalid server address: " << host << std::endl;
+        return 0;
+    }
+    addr.m_port = port;
+
+    std::cout << std::format("Server Addr: {}, Port: {}\n", host, port) << std::endl;
+
+    chat_client client;
+    if (!client.connect(addr, settings))
+    {
+        std::cout << "Too bad..." << std::endl;
+        return 0;
+    }
+
+    if (settings.headless)
+        std::cout << "Connection requested, measuring the round-trip latency." << std::endl;
+    else
+        std::cout << "Connection requested, type /quit to quit.\n" << std::endl;
+
+    client.run();
+
+    if (settings.headless)
+        client.print_probe_summary();
+
+    client.stop(500);
+
+    std::cout << "Quited!" << std::endl;
 }
@@ -26,6 +26,9 @@ public partial class ChatScene : Control
 
         Label label = new() { Text = "To change your name, type /name <your new name>." };
         this.chatLogVBox.AddChild(label);
+
+        label = new() { Text = "To chat in a room, type /join <room>, then /room <room> <message>. /leave <room> leaves it." };
+        this.chatLogVBox.AddChild(label);
     }
 
     /// <inheritdoc/>
@@ -63,6 +66,42 @@ public partial class ChatScene : Control
                 }
             }
 
+            // If the user requested to join or leave a room
+            else if (split.Length > 0 && (split[0] == "/join" || split[0] == "/leave"))
+            {
+                if (split.Length < 2)
+                {
+                    this.AddLine($"You should provide a room name after {split[0]}");
+                }
+                else
+                {
+                    string room = string.Join(' ', split[1..]);
+                    msg = (split[0] == "/join")
+                        ? new() { JoinRoom = new() { Room = room } }
+                        : new() { LeaveRoom = new() { Room = room } };
+                }
+            }
+
+            // If the user typed a chat message to a room, as `/room <room> <message>`
+            else if (split.Length > 0 && split[0] == "/room")
+            {
+                if (split.Length < 3)
+                {
+                    this.AddLine("You should provide a room name and a message after /room");
+                }
+                else
+                {
+                    string content = string.Join(' ', split[2..]);
+                    msg = new()
+                    {
+                        Chat = new() { Room = split[1], Content = content },
+                    };
+
+                    // Add chat as a label to the vbox
+                    this.AddLine($"[{split[1]}] You: {content}");
+                }
+            }
+
             // If the user typed a chat message
             else
             {
@@ -99,7 +138,15 @@ public partial class ChatScene : Control
             }
 
             // Add chat as a label to the vbox
-            this.AddLine($"{chat.Chat.SenderName ?? "(Invalid sender)"}: {chat.Chat.Content}");
+            this.AddChatLine(chat.Chat);
+        }
+        else if (chat.MsgCase == ChatProtocol.MsgOneofCase.ChatBatch)
+        {
+            // Add each chat coalesced by the server as a label to the vbox
+            foreach (Chat batchedChat in chat.ChatBatch.Chats)
+            {
+                this.AddChatLine(batchedChat);
+            }
         }
         else
         {
@@ -125,4 +172,17 @@ public partial class ChatScene : Control
         Label label = new() { Text = line };
         this.chatLogVBox.AddChild(label);
     }
+
+    private void AddChatLine(Chat chat)
+    {
+        string sender = chat.SenderName ?? "(Invalid sender)";
+        if (string.IsNullOrEmpty(chat.Room))
+        {
+            this.AddLine($"{sender}: {chat.Content}");
+        }
+        else
+        {
+            this.AddLine($"[{chat.Room}] {sender}: {chat.Content}");
+        }
+    }
 }
@@ -0,0 +1,865 @@
+// SPDX-License-Identifier: 0BSD
+
+// Load generator, which runs thousands of simulated chat clients in a single process against a chat server.
+//
+// Run the server with `--no-rate-limits`, as it would drop most of the load over its per-client rate limits otherwise.
+
+#include "../Proto/ChatProtocol.pb.h"
+
+#include "../STServer/cli_args.hpp"
+#include "../STServer/metrics.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// @brief Distribution of the chat content sizes.
+struct payload_size_distribution
+{
+    enum class kind
+    {
+        fixed,
+        uniform,
+        /// @brief Many short chats with a long tail, like the real chats.
+        lognormal,
+    };
+
+    kind type = kind::fixed;
+    /// @brief Size of `fixed`, lower bound of `uniform`, median of `lognormal`.
+    std::size_t size = 64;
+    /// @brief Upper bound of `uniform` & `lognormal`.
+    std::size_t max_size = 64;
+    /// @brief Standard deviation of the log of the sizes of `lognormal`.
+    double sigma = 1.0;
+
+    /// @brief Parse `<bytes>`, `<min>-<max>`, or `lognormal:<median>:<sigma>[:<max>]`.
+    static bool parse(std::string_view str, payload_size_distribution& out)
+    {
+        auto parse_size = [](std::string_view s, std::size_t& size) {
+            return std::from_chars(s.data(), s.data() + s.size(), size).ec == std::errc{} && size <= MAX_SIZE;
+        };
+
+        if (str.starts_with("lognormal:"))
+        {
+            str.remove_prefix(std::strlen("lognormal:"));
+            const auto sigma_pos = str.find(':');
+            if (sigma_pos == std::string_view::npos)
+                return false;
+            const auto max_pos = str.find(':', sigma_pos + 1);
+
+            out.type = kind::lognormal;
+            out.max_size = MAX_SIZE;
+            const std::string sigma(str.substr(sigma_pos + 1, max_pos - sigma_pos - 1));
+            char* end;
+            out.sigma = std::strtod(sigma.c_str(), &end);
+            if (!parse_size(str.substr(0, sigma_pos), out.size) || sigma.empty() || *end != '\0' || out.sigma < 0)
+                return false;
+            return max_pos == std::string_view::npos || parse_size(str.substr(max_pos + 1), out.max_size);
+        }
+
+        if (const auto dash = str.find('-'); dash != std::string_view::npos)
+        {
+            out.type = kind::uniform;
+            return parse_size(str.substr(0, dash), out.size) && parse_size(str.substr(dash + 1), out.max_size) &&
+                   out.size <= out.max_size;
+        }
+
+        out.type = kind::fixed;
+        return parse_size(str, out.size);
+    }
+
+    template <typename Rng>
+    auto sample(Rng& rng) const -> std::size_t
+    {
+        switch (type)
+        {
+        case kind::uniform:
+            return std::uniform_int_distribution<std::size_t>(size, max_size)(rng);
+        case kind::lognormal:
+            return std::min(max_size,
+                            (std::size_t)std::lognormal_distribution<double>(std::log((double)size), sigma)(rng));
+        default:
+            return size;
+        }
+    }
+
+    auto to_string() const -> std::string
+    {
+        switch (type)
+        {
+        case kind::uniform:
+            return std::format("uniform {}-{} bytes", size, max_size);
+        case kind::lognormal:
+            return std::format("lognormal median {} bytes, sigma {}, max {} bytes", size, sigma, max_size);
+        default:
+            return std::format("{} bytes", size);
+        }
+    }
+
+    static constexpr std::size_t MAX_SIZE = 256 * 1024;
+};
+
+class chat_loadgen
+{
+public:
+    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
+    static constexpr int MAX_MESSAGES_PER_RECEIVE = 256;
+
+    /// @brief Upper bound of a single blocking wait on the sockets, while sending.
+    /// The sends are paced on every pass, so this bounds how bursty they are.
+    static constexpr int SEND_POLL_WAIT_MILLISECONDS = 1;
+
+    /// @brief How long to keep receiving after the run, for the chats still in flight.
+    static constexpr SteamNetworkingMicroseconds DRAIN_USEC = 1'000'000;
+
+    /// @brief Runtime settings of the load generator.
+    struct settings
+    {
+        int client_count = 1000;
+
+        /// @brief Connections opened per second, until all the clients are opened.
+        double connects_per_second = 500;
+
+        /// @brief Chats per second, per connected client.
+        /// Keep this under the chat rate limit of the server, or the server drops some of them.
+        double chats_per_second = 1;
+
+        /// @brief Name changes per second, per connected client.
+        double name_changes_per_second = 0;
+
+        /// @brief Clients are spread over this many rooms, and chat only to their rooms.
+        /// Zero for all the clients chatting to everyone, which fans out every chat to all of them.
+        int room_count = 0;
+
+        payload_size_distribution payload_size;
+
+        /// @brief How long to run, from the first connection.
+        std::chrono::seconds duration{30};
+
+        /// @brief How often the throughput & latency are reported.
+        std::chrono::seconds report_interval{1};
+
+        std::uint64_t seed = 1;
+    };
+
+private:
+    enum class client_state
+    {
+        idle,
+        connecting,
+        connected,
+        closed,
+    };
+
+    struct sim_client
+    {
+        HSteamNetConnection conn = k_HSteamNetConnection_Invalid;
+        client_state state = client_state::idle;
+        SteamNetworkingMicroseconds connect_start = 0;
+        std::uint32_t name_changes = 0;
+    };
+
+    /// @brief Counters since the start, to report the rates over an interval as the difference.
+    struct totals
+    {
+        std::uint64_t chats_sent = 0;
+        std::uint64_t chat_bytes_sent = 0;
+        std::uint64_t name_changes_sent = 0;
+        std::uint64_t chats_received = 0;
+        std::uint64_t bytes_received = 0;
+        std::uint64_t send_failures = 0;
+    };
+
+private:
+    // The connection status changed callback is a plain function pointer, so it reaches the instance through this.
+    // The connection user data is taken by the client index.
+    static inline chat_loadgen* _instance = nullptr;
+
+    bool _disposed = true;
+
+    bool _gns_initialized = false;
+
+    settings _settings;
+    std::vector<SteamNetworkingIPAddr> _server_addrs;
+
+    HSteamNetPollGroup _poll_group = k_HSteamNetPollGroup_Invalid;
+
+    std::vector<sim_client> _clients;
+    // Connected clients, in the order they send
+    std::vector<std::uint32_t> _connected;
+    std::size_t _next_sender = 0;
+
+    std::mt19937_64 _rng;
+    // Tags the chats of this run, so the ones from other clients on the server are told apart
+    std::uint64_t _nonce = 0;
+
+    std::vector<SteamNetworkingMessage_t*> _received_msgs;
+    std::vector<SteamNetworkingMessage_t*> _outgoing_msgs;
+    std::vector<int64> _message_numbers;
+
+    // Reused for every message, to avoid allocating on each one
+    GNSPrac::Chat::ChatProtocol _received;
+    GNSPrac::Chat::ChatProtocol _outgoing;
+    std::string _send_buffer;
+    std::string _content;
+
+    SteamNetworkingMicroseconds _start_time = 0;
+    SteamNetworkingMicroseconds _last_pass_time = 0;
+    int _opened_count = 0;
+    double _chat_credit = 0;
+    double _name_change_credit = 0;
+
+    totals _totals;
+    totals _reported_totals;
+    SteamNetworkingMicroseconds _next_report_time = 0;
+    SteamNetworkingMicroseconds _last_report_time = 0;
+
+    std::uint64_t _connect_failures = 0;
+    std::uint64_t _disconnects = 0;
+
+    histogram _connect_time_us;
+    histogram _latency_us;
+    histogram _interval_latency_us;
+
+public:
+    chat_loadgen() = default;
+
+    // Callbacks are routed to this load generator by its address
+    chat_loadgen(const chat_loadgen&) = delete;
+    chat_loadgen& operator=(const chat_loadgen&) = delete;
+
+    ~chat_loadgen()
+    {
+        dispose();
+    }
+
+public:
+    /// @brief Initialize the GNS, to open the clients against the servers later in `run()`.
+    /// @param server_addrs Addresses of the servers; the clients are spread over them.
+    /// @param loadgen_settings Runtime settings of the load generator.
+    /// @return Whether it's been initialized, or errored.
+    bool start(std::vector<SteamNetworkingIPAddr> server_addrs, const settings& loadgen_settings)
+    {
+        if (!_disposed || _instance)
+            return false;
+
+        _disposed = false;
+        _instance = this;
+
+        try
+        {
+            _settings = loadgen_settings;
+            _server_addrs = std::move(server_addrs);
+            _received_msgs.resize(MAX_MESSAGES_PER_RECEIVE);
+
+            _rng.seed(_settings.seed);
+            _nonce = std::random_device{}();
+            _nonce = (_nonce << 32) | std::random_device{}();
+
+            _clients.assign((std::size_t)_settings.client_count, sim_client{});
+            _connected.clear();
+            _connected.reserve(_clients.size());
+
+            // Service the sockets from the loop, instead of the GNS's internal service thread.
+            // Note that this must be set before initializing `GameNetworkingSockets`.
+            SteamNetworkingSockets_SetManualPollMode(true);
+
+            SteamDatagramErrMsg err_msg;
+            if (!GameNetworkingSockets_Init(nullptr, err_msg))
+                throw std::runtime_error(err_msg);
+            _gns_initialized = true;
+
+            SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Warning,
+                                                           on_gns_debug_output);
+
+            // Receive from all the clients at once
+            _poll_group = SteamNetworkingSockets()->CreatePollGroup();
+        }
+        catch (const std::exception& ex)
+        {
+            std::cout << "Failed to start chat_loadgen: " << ex.what() << std::endl;
+
+            dispose();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Open the clients, and run the load for the duration.
+    void run()
+    {
+        _start_time = SteamNetworkingUtils()->GetLocalTimestamp();
+        _last_pass_time = _start_time;
+        _last_report_time = _start_time;
+        _next_report_time = _start_time + std::chrono::microseconds(_settings.report_interval).count();
+
+        const SteamNetworkingMicroseconds end_time =
+            _start_time + std::chrono::microseconds(_settings.duration).count();
+
+        for (auto now = _start_time; now < end_time + DRAIN_USEC; now = SteamNetworkingUtils()->GetLocalTimestamp())
+        {
+            // Block until the sockets have something for us, or it's time to send more
+            SteamNetworkingSockets_Poll(SEND_POLL_WAIT_MILLISECONDS);
+            SteamNetworkingSockets()->RunCallbacks();
+
+            receive_messages();
+
+            const double elapsed_seconds = (double)(now - _last_pass_time) / 1'000'000.0;
+            _last_pass_time = now;
+
+            // Keep receiving after the run, but stop sending
+            if (now < end_time)
+            {
+                open_clients(now);
+                send_chats(elapsed_seconds);
+                send_name_changes(elapsed_seconds);
+            }
+
+            if (now >= _next_report_time)
+            {
+                print_report(now);
+                _next_report_time = now + std::chrono::microseconds(_settings.report_interval).count();
+            }
+        }
+    }
+
+    /// @brief Print the throughput, latency and connect time of the whole run.
+    void print_summary() const
+    {
+        const double seconds = (double)(_last_pass_time - _start_time) / 1'000'000.0;
+        const auto latency = _latency_us.get_summary();
+        const auto connect_time = _connect_time_us.get_summary();
+
+        std::cout << "\n=== Summary ===" << std::endl;
+        std::cout << std::format("Clients: {} opened, {} connected, {} failed to connect, {} disconnected",
+                                 _opened_count, _connect_time_us.get_summary().count, _connect_failures,
+                                 _disconnects)
+                  << std::endl;
+        std::cout << std::format("Connect time: mean {:.1f}us, p50 {}us, p90 {}us, p99 {}us, max {}us",
+                                 connect_time.mean, connect_time.p50, connect_time.p90, connect_time.p99,
+                                 connect_time.max)
+                  << std::endl;
+        std::cout << std::format("Sent: {} chats ({:.0f}/s, {:.2f}MiB/s of content), {} name changes, "
+                                 "{} send failures",
+                                 _totals.chats_sent, (double)_totals.chats_sent / seconds,
+                                 (double)_totals.chat_bytes_sent / seconds / (1024 * 1024),
+                                 _totals.name_changes_sent, _totals.send_failures)
+                  << std::endl;
+        std::cout << std::format("Received: {} chats ({:.0f}/s, {:.2f}MiB/s)", _totals.chats_received,
+                                 (double)_totals.chats_received / seconds,
+                                 (double)_totals.bytes_received / seconds / (1024 * 1024))
+                  << std::endl;
+        std::cout << std::format("End-to-end latency: mean {:.1f}us, p50 {}us, p90 {}us, p99 {}us, p99.9 {}us, "
+                                 "max {}us",
+                                 latency.mean, latency.p50, latency.p90, latency.p99, latency.p999, latency.max)
+                  << std::endl;
+    }
+
+    /// @brief Close all the clients, and kill the GNS.
+    void dispose()
+    {
+        if (!_disposed)
+        {
+            if (_gns_initialized)
+            {
+                for (auto& client : _clients)
+                {
+                    if (client.conn != k_HSteamNetConnection_Invalid)
+                        SteamNetworkingSockets()->CloseConnection(client.conn, 0, "Load generator quit", false);
+                    client.conn = k_HSteamNetConnection_Invalid;
+                }
+
+                if (_poll_group != k_HSteamNetPollGroup_Invalid)
+                {
+                    SteamNetworkingSockets()->DestroyPollGroup(_poll_group);
+                    _poll_group = k_HSteamNetPollGroup_Invalid;
+                }
+
+                GameNetworkingSockets_Kill();
+                _gns_initialized = false;
+            }
+
+            _clients.clear();
+            _connected.clear();
+
+            _instance = nullptr;
+            _disposed = true;
+        }
+    }
+
+private:
+    static void on_gns_debug_output(ESteamNetworkingSocketsDebugOutputType, const char* msg)
+    {
+        std::cerr << "[GNS] " << msg << std::endl;
+    }
+
+    /// @brief Open the clients due by the connect ramp.
+    void open_clients(SteamNetworkingMicroseconds now)
+    {
+        const double elapsed_seconds = (double)(now - _start_time) / 1'000'000.0;
+        const int due = (int)std::min<double>(_settings.client_count,
+                                              std::floor(elapsed_seconds * _settings.connects_per_second) + 1);
+
+        for (; _opened_count < due; ++_opened_count)
+        {
+            const auto index = (std::uint32_t)_opened_count;
+            sim_client& client = _clients[index];
+
+            // Route the callbacks & the received messages of this connection to its client,
+            // via the connection user data
+            SteamNetworkingConfigValue_t configs[2]{};
+            configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                              (void*)on_connection_status_changed);
+            configs[1].SetInt64(k_ESteamNetworkingConfig_ConnectionUserData, (int64)index);
+
+            const auto& addr = _server_addrs[index % _server_addrs.size()];
+            client.connect_start = now;
+            client.conn = SteamNetworkingSockets()->ConnectByIPAddress(addr, 2, configs);
+            if (client.conn == k_HSteamNetConnection_Invalid)
+            {
+                client.state = client_state::closed;
+                ++_connect_failures;
+                continue;
+            }
+
+            client.state = client_state::connecting;
+            SteamNetworkingSockets()->SetConnectionPollGroup(client.conn, _poll_group);
+        }
+    }
+
+    /// @brief Callback that's called from the GNS when connection status changed.
+    /// As the GNS is on the manual poll mode, it's called on the loop, within `RunCallbacks()`.
+    static void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
+    {
+        if (_instance)
+            _instance->handle_status_change(*info);
+    }
+
+    void handle_status_change(const SteamNetConnectionStatusChangedCallback_t& info)
+    {
+        const auto index = (std::size_t)info.m_info.m_nUserData;
+        if (index >= _clients.size() || _clients[index].conn != info.m_hConn)
+            return;
+        sim_client& client = _clients[index];
+
+        switch (info.m_info.m_eState)
+        {
+        case k_ESteamNetworkingConnectionState_Connected: {
+            const SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+            _connect_time_us.record((std::uint64_t)(now - client.connect_start));
+
+            client.state = client_state::connected;
+            _connected.push_back((std::uint32_t)index);
+
+            if (_settings.room_count > 0)
+            {
+                _outgoing.Clear();
+                _outgoing.mutable_join_room()->set_room(room_of(index));
+                send(client.conn, _outgoing);
+            }
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+            if (client.state == client_state::connected)
+            {
+                ++_disconnects;
+                _connected.erase(std::find(_connected.begin(), _connected.end(), (std::uint32_t)index));
+            }
+            else
+            {
+                ++_connect_failures;
+            }
+
+            if (_disconnects + _connect_failures <= 10)
+            {
+                std::cout << std::format("Client {}: {}, reason {}: {}", index,
+                                         info.m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
+                                             ? "closed by peer"
+                                             : "problem detected locally",
+                                         info.m_info.m_eEndReason, info.m_info.m_szEndDebug)
+                          << std::endl;
+            }
+
+            SteamNetworkingSockets()->CloseConnection(client.conn, 0, nullptr, false);
+            client.conn = k_HSteamNetConnection_Invalid;
+            client.state = client_state::closed;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    auto room_of(std::size_t index) const -> std::string
+    {
+        return std::format("load-{}", index % (std::size_t)_settings.room_count);
+    }
+
+    /// @brief Send the chats due by the message rate, round-robin over the connected clients.
+    void send_chats(double elapsed_seconds)
+    {
+        if (_connected.empty())
+        {
+            _chat_credit = 0;
+            return;
+        }
+
+        _chat_credit += elapsed_seconds * _settings.chats_per_second * (double)_connected.size();
+        // Don't burst more than a second worth of chats, if the loop was late
+        _chat_credit = std::min(_chat_credit, _settings.chats_per_second * (double)_connected.size());
+
+        const SteamNetworkingMicroseconds now = SteamNetworkingUtils()->GetLocalTimestamp();
+        for (; _chat_credit >= 1; _chat_credit -= 1)
+        {
+            _next_sender = _next_sender < _connected.size() ? _next_sender : 0;
+            const std::uint32_t index = _connected[_next_sender++];
+
+            // "lg <nonce> <send time> ", padded up to the payload size
+            const std::size_t size = _settings.payload_size.sample(_rng);
+            _content = std::format("lg {:016x} {} ", _nonce, now);
+            if (_content.size() < size)
+                _content.resize(size, '.');
+
+            _outgoing.Clear();
+            auto& chat = *_outgoing.mutable_chat();
+            chat.set_content(_content);
+            if (_settings.room_count > 0)
+                chat.set_room(room_of(index));
+
+            queue(_clients[index].conn, _outgoing);
+            ++_totals.chats_sent;
+            _totals.chat_bytes_sent += _content.size();
+        }
+
+        flush_outgoing();
+    }
+
+    /// @brief Send the name changes due by the churn rate, from random connected clients.
+    void send_name_changes(double elapsed_seconds)
+    {
+        if (_connected.empty() || _settings.name_changes_per_second <= 0)
+        {
+            _name_change_credit = 0;
+            return;
+        }
+
+        _name_change_credit += elapsed_seconds * _settings.name_changes_per_second * (double)_connected.size();
+        _name_change_credit =
+            std::min(_name_change_credit, _settings.name_changes_per_second * (double)_connected.size());
+
+        for (; _name_change_credit >= 1; _name_change_credit -= 1)
+        {
+            const std::uint32_t index =
+                _connected[std::uniform_int_distribution<std::size_t>(0, _connected.size() - 1)(_rng)];
+            sim_client& client = _clients[index];
+
+            _outgoing.Clear();
+            _outgoing.mutable_name_change()->set_name(std::format("Load#{}.{}", index, client.name_changes++));
+
+            queue(client.conn, _outgoing);
+            ++_totals.name_changes_sent;
+        }
+
+        flush_outgoing();
+    }
+
+    /// @brief Queue a message to be sent with the others in `flush_outgoing()`.
+    void queue(HSteamNetConnection conn, const GNSPrac::Chat::ChatProtocol& msg)
+    {
+        const auto size = (std::uint32_t)msg.ByteSizeLong();
+        SteamNetworkingMessage_t* net_msg = SteamNetworkingUtils()->AllocateMessage((int)size);
+        msg.SerializeWithCachedSizesToArray(static_cast<std::uint8_t*>(net_msg->m_pData));
+        net_msg->m_conn = conn;
+        net_msg->m_nFlags = k_nSteamNetworkingSend_ReliableNoNagle;
+        _outgoing_msgs.push_back(net_msg);
+    }
+
+    /// @brief Submit all the queued messages with a single `SendMessages()` call.
+    void flush_outgoing()
+    {
+        if (_outgoing_msgs.empty())
+            return;
+
+        _message_numbers.resize(_outgoing_msgs.size());
+        SteamNetworkingSockets()->SendMessages((int)_outgoing_msgs.size(), _outgoing_msgs.data(),
+                                               _message_numbers.data());
+        for (const auto result : _message_numbers)
+            if (result < 0)
+                ++_totals.send_failures;
+
+        _outgoing_msgs.clear();
+    }
+
+    void send(HSteamNetConnection conn, const GNSPrac::Chat::ChatProtocol& msg)
+    {
+        msg.SerializeToString(&_send_buffer);
+        SteamNetworkingSockets()->SendMessageToConnection(conn, _send_buffer.data(), (uint32)_send_buffer.size(),
+                                                          k_nSteamNetworkingSend_ReliableNoNagle, nullptr);
+    }
+
+    void receive_messages()
+    {
+        while (true)
+        {
+            const int received_msg_count = SteamNetworkingSockets()->ReceiveMessagesOnPollGroup(
+                _poll_group, _received_msgs.data(), MAX_MESSAGES_PER_RECEIVE);
+            if (received_msg_count == -1)
+                throw std::runtime_error("receive msg failed");
+
+            for (int i = 0; i < received_msg_count; ++i)
+            {
+                on_message(*_received_msgs[i]);
+
+                _received_msgs[i]->Release();
+            }
+
+            if (received_msg_count < MAX_MESSAGES_PER_RECEIVE)
+                break;
+        }
+    }
+
+    void on_message(const SteamNetworkingMessage_t& net_msg)
+    {
+        _totals.bytes_received += (std::uint64_t)net_msg.m_cbSize;
+
+        if (net_msg.m_cbSize == 0 || !_received.ParseFromArray(net_msg.m_pData, net_msg.m_cbSize))
+            return;
+
+        switch (_received.msg_case())
+        {
+        case GNSPrac::Chat::ChatProtocol::kChat:
+            on_chat(_received.chat().content(), net_msg.m_usecTimeReceived);
+            break;
+
+        case GNSPrac::Chat::ChatProtocol::kChatBatch:
+            for (const auto& chat : _received.chat_batch().chats())
+                on_chat(chat.content(), net_msg.m_usecTimeReceived);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    void on_chat(std::string_view content, SteamNetworkingMicroseconds received_time)
+    {
+        // Parse "lg <nonce> <send time> "; the notices from the server & the chats from others don't count
+        constexpr std::string_view prefix = "lg ";
+        constexpr std::size_t nonce_length = 16;
+        if (!content.starts_with(prefix) || content.size() < prefix.size() + nonce_length + 1)
+            return;
+        content.remove_prefix(prefix.size());
+
+        std::uint64_t nonce;
+        if (std::from_chars(content.data(), content.data() + nonce_length, nonce, 16).ec != std::errc{} ||
+            nonce != _nonce)
+            return;
+        content.remove_prefix(nonce_length + 1);
+
+        SteamNetworkingMicroseconds sent_time;
+        if (std::from_chars(content.data(), content.data() + content.size(), sent_time).ec != std::errc{})
+            return;
+
+        ++_totals.chats_received;
+
+        const auto latency = (std::uint64_t)std::max<SteamNetworkingMicroseconds>(received_time - sent_time, 0);
+        _latency_us.record(latency);
+        _interval_latency_us.record(latency);
+    }
+
+    void print_report(SteamNetworkingMicroseconds now)
+    {
+        const double seconds = (double)(now - _last_report_time) / 1'000'000.0;
+        const auto latency = _interval_latency_us.get_summary();
+
+        std::cout << std::format("[{:5.1f}s] Connected: {}/{}, sent: {:.0f} chats/s, received: {:.0f} chats/s "
+                                 "({:.2f}MiB/s), latency p50/p99/max: {}/{}/{}us",
+                                 (double)(now - _start_time) / 1'000'000.0, _connected.size(), _settings.client_count,
+                                 (double)(_totals.chats_sent - _reported_totals.chats_sent) / seconds,
+                                 (double)(_totals.chats_received - _reported_totals.chats_received) / seconds,
+                                 (double)(_totals.bytes_received - _reported_totals.bytes_received) / seconds /
+                                     (1024 * 1024),
+                                 latency.p50, latency.p99, latency.max)
+                  << std::endl;
+
+        _interval_latency_us.reset();
+        _reported_totals = _totals;
+        _last_report_time = now;
+    }
+};
+
+int main(int argc, char** args)
+{
+    std::cout << "GNS-Practice #00: Chat" << std::endl;
+    std::cout << "Load generator in C++ with GameNetworkingSockets\n" << std::endl;
+
+    // Parse the server address and options from `args`
+    // Usage: chat_loadgen [host] [port] [--servers=<count>] [--clients=<count>] [--connect-rate=<per second>]
+    //                     [--chat-rate=<per second per client>] [--name-churn=<per second per client>]
+    //                     [--rooms=<count>] [--size=<bytes>|<min>-<max>|lognormal:<median>:<sigma>[:<max>]]
+    //                     [--duration-s=<seconds>] [--seed=<seed>]
+    std::string_view host;
+    std::uint16_t port = chat_loadgen::DEFAULT_SERVER_PORT;
+    int server_count = 1;
+    int positional_count = 0;
+    chat_loadgen::settings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = args[i];
+        const std::string_view value = arg.substr(arg.find('=') + 1);
+
+        long number;
+        if (arg.starts_with("--servers="))
+        {
+            if (!parse_long(value, number) || number <= 0 || number > 1024)
+            {
+                std::cout << "Invalid server count: " << arg << std::endl;
+                return 0;
+            }
+            server_count = (int)number;
+        }
+        else if (arg.starts_with("--clients="))
+        {
+            if (!parse_long(value, number) || number <= 0 || number > 1'000'000)
+            {
+                std::cout << "Invalid client count: " << arg << std::endl;
+                return 0;
+            }
+            settings.client_count = (int)number;
+        }
+        else if (arg.starts_with("--connect-rate="))
+        {
+            if (!parse_double(value, settings.connects_per_second) || settings.connects_per_second <= 0)
+            {
+                std::cout << "Invalid connect rate: " << arg << std::endl;
+                return 0;
+            }
+        }
+        else if (arg.starts_with("--chat-rate="))
+        {
+            if (!parse_double(value, settings.chats_per_second) || settings.chats_per_second < 0)
+            {
+                std::cout << "Invalid chat rate: " << arg << std::endl;
+                return 0;
+            }
+        }
+        else if (arg.starts_with("--name-churn="))
+        {
+            if (!parse_double(value, settings.name_changes_per_second) || settings.name_changes_per_second < 0)
+            {
+                std::cout << "Invalid name churn: " << arg << std::endl;
+                return 0;
+            }
+        }
+        else if (arg.starts_with("--rooms="))
+        {
+            if (!parse_long(value, number) || number < 0 || number > 1'000'000)
+            {
+                std::cout << "Invalid room count: " << arg << std::endl;
+                return 0;
+            }
+            settings.room_count = (int)number;
+        }
+        else if (arg.starts_with("--size="))
+        {
+            if (!payload_size_distribution::parse(value, settings.payload_size))
+            {
+                std::cout << "Invalid payload size: " << arg << std::endl;
+                return 0;
+            }
+        }
+        else if (arg.starts_with("--duration-s="))
+        {
+            if (!parse_long(value, number) || number <= 0)
+            {
+                std::cout << "Invalid duration: " << arg << std::endl;
+                return 0;
+            }
+            settings.duration = std::chrono::seconds(number);
+        }
+        else if (arg.starts_with("--seed="))
+        {
+            if (!parse_long(value, number))
+            {
+                std::cout << "Invalid seed: " << arg << std::endl;
+                return 0;
+            }
+            settings.seed = (std::uint64_t)number;
+        }
+        else if (positional_count++ == 0)
+        {
+            host = arg;
+        }
+        else
+        {
+            if (!parse_long(arg, number) || number < 0 || number >= 65536)
+            {
+                std::cout << "Invalid port: " << arg << std::endl;
+                return 0;
+            }
+            port = (std::uint16_t)number;
+        }
+    }
+
+    if (port + server_count - 1 >= 65536)
+    {
+        std::cout << std::format("Not enough ports for {} servers from {}", server_count, port) << std::endl;
+        return 0;
+    }
+
+    // Setup the addresses; only numeric addresses are supported, and an empty one is the local host
+    std::vector<SteamNetworkingIPAddr> server_addrs(server_count);
+    for (int i = 0; i < server_count; ++i)
+    {
+        auto& addr = server_addrs[i];
+        if (host.empty() || host == "localhost")
+        {
+            addr.SetIPv6LocalHost();
+        }
+        else if (!addr.ParseString(std::string(host).c_str()))
+        {
+            std::cout << "Invalid server address: " << host << std::endl;
+            return 0;
+        }
+        addr.m_port = (std::uint16_t)(port + i);
+    }
+
+    std::cout << std::format("Server Addr: {}, Ports: {}-{}", host, port, port + server_count - 1) << std::endl;
+    std::cout << std::format("Clients: {}, connect rate: {}/s, chat rate: {}/s/client, name churn: {}/s/client, "
+                             "rooms: {}, payload: {}, duration: {}s\n",
+                             settings.client_count, settings.connects_per_second, settings.chats_per_second,
+                             settings.name_changes_per_second, settings.room_count,
+                             settings.payload_size.to_string(), settings.duration.count())
+              << std::endl;
+
+    chat_loadgen loadgen;
+    if (!loadgen.start(std::move(server_addrs), settings))
+    {
+        std::cout << "Too bad..." << std::endl;
+        return 0;
+    }
+
+    loadgen.run();
+    loadgen.print_summary();
+    loadgen.dispose();
+}
@@ -0,0 +1,636 @@
+// SPDX-License-Identifier: 0BSD
+
+// Replays a traffic capture of `st_chat_server --capture=<path>` against a server,
+// to reproduce the real traffic shapes on a dev box, and to compare builds on the same input.
+//
+// Every client in the capture is replayed as its own connection, opened, fed and closed on the captured schedule,
+// scaled by the speed; the messages are sent as captured, byte for byte.
+//
+// Run the server with `--no-rate-limits`, as it would drop much of the replay otherwise,
+// especially when replaying faster than captured.
+
+#include "../STServer/cli_args.hpp"
+#include "../STServer/metrics.hpp"
+#include "../STServer/traffic_capture.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class chat_replay
+{
+public:
+    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
+    static constexpr int MAX_MESSAGES_PER_RECEIVE = 256;
+
+    /// @brief Upper bound of a single blocking wait on the sockets, while replaying.
+    /// The records are replayed on every pass, so this bounds how late they can be.
+    static constexpr int REPLAY_POLL_WAIT_MILLISECONDS = 1;
+
+    /// @brief Records replayed in a single pass at most, so that the sockets are serviced in between at full speed.
+    static constexpr int MAX_RECORDS_PER_PASS = 1024;
+
+    /// @brief How long to keep running after the last record, for the connections still connecting.
+    static constexpr SteamNetworkingMicroseconds DRAIN_USEC = 1'000'000;
+
+    /// @brief Runtime settings of the replay.
+    struct settings
+    {
+        /// @brief How many times faster than captured to replay, e.g. 1 for the same pace.
+        /// Zero replays as fast as possible.
+        double speed = 1;
+
+        /// @brief How often the throughput & lag are reported.
+        std::chrono::seconds report_interval{1};
+    };
+
+private:
+    enum class client_state
+    {
+        connecting,
+        connected,
+        closed,
+    };
+
+    struct replay_client
+    {
+        HSteamNetConnection conn = k_HSteamNetConnection_Invalid;
+        client_state state = client_state::connecting;
+
+        // Messages due while it was still connecting, sent as soon as it's connected
+        std::vector<std::vector<std::byte>> pending;
+        // Whether the capture closed it while it was still connecting
+        bool close_when_connected = false;
+    };
+
+    /// @brief Counters since the start, to report the rates over an interval as the difference.
+    struct totals
+    {
+        std::uint64_t records = 0;
+        std::uint64_t messages_sent = 0;
+        std::uint64_t bytes_sent = 0;
+        /// @brief Messages of the clients that weren't connected, e.g. failed to connect or closed by the server.
+        std::uint64_t skipped_messages = 0;
+        std::uint64_t send_failures = 0;
+        std::uint64_t messages_received = 0;
+        std::uint64_t bytes_received = 0;
+    };
+
+private:
+    // The connection status changed callback is a plain function pointer, so it reaches the instance through this.
+    // The connection user data is taken by the client index.
+    static inline chat_replay* _instance = nullptr;
+
+    bool _disposed = true;
+
+    bool _gns_initialized = false;
+
+    settings _settings;
+    SteamNetworkingIPAddr _server_addr{};
+
+    std::unique_ptr<traffic_capture::reader> _reader;
+    traffic_capture::record _next_record{};
+    bool _has_next_record = false;
+
+    HSteamNetPollGroup _poll_group = k_HSteamNetPollGroup_Invalid;
+
+    std::vector<replay_client> _clients;
+    // Clients by their connections in the capture
+    std::unordered_map<HSteamNetConnection, std::uint32_t> _captured_clients;
+
+    std::vector<SteamNetworkingMessage_t*> _received_msgs;
+    std::vector<SteamNetworkingMessage_t*> _outgoing_msgs;
+    std::vector<int64> _message_numbers;
+
+    SteamNetworkingMicroseconds _start_time = 0;
+    SteamNetworkingMicroseconds _last_pass_time = 0;
+    // Capture time of the last replayed record
+    std::uint64_t _replayed_time_us = 0;
+
+    totals _totals;
+    totals _reported_totals;
+    SteamNetworkingMicroseconds _next_report_time = 0;
+    SteamNetworkingMicroseconds _last_report_time = 0;
+
+    std::uint64_t _connects = 0;
+    std::uint64_t _connect_failures = 0;
+    std::uint64_t _disconnects = 0;
+    // Closed by the server, or the connection was lost
+    std::uint64_t _lost_connections = 0;
+
+    // How late the records are replayed, compared to the captured schedule
+    histogram _lag_us;
+    histogram _interval_lag_us;
+
+public:
+    chat_replay() = default;
+
+    // Callbacks are routed to this replay by its address
+    chat_replay(const chat_replay&) = delete;
+    chat_replay& operator=(const chat_replay&) = delete;
+
+    ~chat_replay()
+    {
+        dispose();
+    }
+
+public:
+    /// @brief Open the capture and initialize the GNS, to replay it later in `run()`.
+    /// @param capture_path Capture file written by `st_chat_server --capture=<path>`.
+    /// @param server_addr Address of the server to replay against.
+    /// @param replay_settings Runtime settings of the replay.
+    /// @return Whether it's been initialized, or errored.
+    bool start(const std::string& capture_path, const SteamNetworkingIPAddr& server_addr,
+               const settings& replay_settings)
+    {
+        if (!_disposed || _instance)
+            return false;
+
+        _disposed = false;
+        _instance = this;
+
+        try
+        {
+            _settings = replay_settings;
+            _server_addr = server_addr;
+            _received_msgs.resize(MAX_MESSAGES_PER_RECEIVE);
+
+            _reader = std::make_unique<traffic_capture::reader>(capture_path);
+            _has_next_record = _reader->next(_next_record);
+
+            // Service the sockets from the loop, instead of the GNS's internal service thread.
+            // Note that this must be set before initializing `GameNetworkingSockets`.
+            SteamNetworkingSockets_SetManualPollMode(true);
+
+            SteamDatagramErrMsg err_msg;
+            if (!GameNetworkingSockets_Init(nullptr, err_msg))
+                throw std::runtime_error(err_msg);
+            _gns_initialized = true;
+
+            SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Warning,
+                                                           on_gns_debug_output);
+
+            // Receive from all the clients at once
+            _poll_group = SteamNetworkingSockets()->CreatePollGroup();
+        }
+        catch (const std::exception& ex)
+        {
+            std::cout << "Failed to start chat_replay: " << ex.what() << std::endl;
+
+            dispose();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Replay the whole capture.
+    void run()
+    {
+        _start_time = SteamNetworkingUtils()->GetLocalTimestamp();
+        _last_pass_time = _start_time;
+        _last_report_time = _start_time;
+        _next_report_time = _start_time + std::chrono::microseconds(_settings.report_interval).count();
+
+        SteamNetworkingMicroseconds end_time = 0;
+        for (auto now = _start_time; end_time == 0 || now < end_time; now = SteamNetworkingUtils()->GetLocalTimestamp())
+        {
+            _last_pass_time = now;
+
+            replay_due_records(now);
+            flush_outgoing();
+            if (!_has_next_record && end_time == 0)
+                end_time = now + DRAIN_USEC;
+
+            // Block until the sockets have something for us, or it's time to replay more.
+            // As fast as possible, only service the sockets in between.
+            SteamNetworkingSockets_Poll(_settings.speed > 0 ? REPLAY_POLL_WAIT_MILLISECONDS : 0);
+            SteamNetworkingSockets()->RunCallbacks();
+
+            receive_messages();
+
+            // Send what the clients connected just now have been holding
+            flush_outgoing();
+
+            if (now >= _next_report_time)
+            {
+                print_report(now);
+                _next_report_time = now + std::chrono::microseconds(_settings.report_interval).count();
+            }
+        }
+    }
+
+    /// @brief Print the throughput and lag of the whole replay.
+    void print_summary() const
+    {
+        const double seconds = (double)(_last_pass_time - _start_time) / 1'000'000.0;
+        const double captured_seconds = (double)_replayed_time_us / 1'000'000.0;
+        const auto lag = _lag_us.get_summary();
+
+        std::cout << "\n=== Summary ===" << std::endl;
+        std::cout << std::format("Replayed: {} records, {:.1f}s of capture in {:.1f}s (x{:.2f}){}", _totals.records,
+                                 captured_seconds, seconds, captured_seconds / seconds,
+                                 _reader && _reader->is_truncated() ? ", stopped at a truncated record" : "")
+                  << std::endl;
+        std::cout << std::format("Clients: {} connected, {} failed to connect, {} disconnected, {} lost", _connects,
+                                 _connect_failures, _disconnects, _lost_connections)
+                  << std::endl;
+        std::cout << std::format("Sent: {} messages ({:.0f}/s, {:.2f}MiB/s), {} skipped, {} send failures",
+                                 _totals.messages_sent, (double)_totals.messages_sent / seconds,
+                                 (double)_totals.bytes_sent / seconds / (1024 * 1024), _totals.skipped_messages,
+                                 _totals.send_failures)
+                  << std::endl;
+        std::cout << std::format("Received: {} messages ({:.0f}/s, {:.2f}MiB/s)", _totals.messages_received,
+                                 (double)_totals.messages_received / seconds,
+                                 (double)_totals.bytes_received / seconds / (1024 * 1024))
+                  << std::endl;
+        if (_settings.speed > 0)
+        {
+            std::cout << std::format("Lag behind the schedule: mean {:.1f}us, p50 {}us, p90 {}us, p99 {}us, max {}us",
+                                     lag.mean, lag.p50, lag.p90, lag.p99, lag.max)
+                      << std::endl;
+        }
+    }
+
+    /// @brief Close all the clients, and kill the GNS.
+    void dispose()
+    {
+        if (!_disposed)
+        {
+            if (_gns_initialized)
+            {
+                for (auto& client : _clients)
+                {
+                    if (client.state != client_state::closed)
+                        SteamNetworkingSockets()->CloseConnection(client.conn, 0, "Replay quit", false);
+                    client.state = client_state::closed;
+                }
+
+                if (_poll_group != k_HSteamNetPollGroup_Invalid)
+                {
+                    SteamNetworkingSockets()->DestroyPollGroup(_poll_group);
+                    _poll_group = k_HSteamNetPollGroup_Invalid;
+                }
+
+                GameNetworkingSockets_Kill();
+                _gns_initialized = false;
+            }
+
+            _clients.clear();
+            _captured_clients.clear();
+            _reader.reset();
+
+            _instance = nullptr;
+            _disposed = true;
+        }
+    }
+
+private:
+    static void on_gns_debug_output(ESteamNetworkingSocketsDebugOutputType, const char* msg)
+    {
+        std::cerr << "[GNS] " << msg << std::endl;
+    }
+
+    /// @brief When the record should be replayed, scaled by the speed.
+    auto due_time(const traffic_capture::record& record) const -> SteamNetworkingMicroseconds
+    {
+        if (_settings.speed <= 0)
+            return _start_time;
+        return _start_time + (SteamNetworkingMicroseconds)((double)record.time_us / _settings.speed);
+    }
+
+    /// @brief Replay the records due by now, in the captured order.
+    void replay_due_records(SteamNetworkingMicroseconds now)
+    {
+        for (int i = 0; i < MAX_RECORDS_PER_PASS && _has_next_record; ++i)
+        {
+            const SteamNetworkingMicroseconds due = due_time(_next_record);
+            if (due > now)
+                break;
+
+            if (_settings.speed > 0)
+            {
+                _lag_us.record((std::uint64_t)(now - due));
+                _interval_lag_us.record((std::uint64_t)(now - due));
+            }
+
+            replay(_next_record);
+            ++_totals.records;
+            _replayed_time_us = _next_record.time_us;
+
+            _has_next_record = _reader->next(_next_record);
+        }
+    }
+
+    void replay(traffic_capture::record& record)
+    {
+        switch (record.type)
+        {
+        case traffic_capture::record_type::connect:
+            open_client(record.conn);
+            break;
+
+        case traffic_capture::record_type::message: {
+            const auto it = _captured_clients.find(record.conn);
+            if (it == _captured_clients.end())
+            {
+                ++_totals.skipped_messages;
+                break;
+            }
+
+            replay_client& client = _clients[it->second];
+            if (client.state == client_state::connected)
+                queue(client.conn, record.data);
+            else if (client.state == client_state::connecting)
+                client.pending.push_back(std::move(record.data));
+            else
+                ++_totals.skipped_messages;
+            break;
+        }
+
+        case traffic_capture::record_type::disconnect: {
+            const auto it = _captured_clients.find(record.conn);
+            if (it == _captured_clients.end())
+                break;
+
+            replay_client& client = _clients[it->second];
+            _captured_clients.erase(it);
+
+            if (client.state == client_state::connecting)
+                client.close_when_connected = true;
+            else if (client.state == client_state::connected)
+                close_client(client);
+            break;
+        }
+        }
+    }
+
+    void open_client(HSteamNetConnection captured_conn)
+    {
+        const auto index = (std::uint32_t)_clients.size();
+        replay_client& client = _clients.emplace_back();
+
+        // Route the callbacks & the received messages of this connection to its client,
+        // via the connection user data
+        SteamNetworkingConfigValue_t configs[2]{};
+        configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                          (void*)on_connection_status_changed);
+        configs[1].SetInt64(k_ESteamNetworkingConfig_ConnectionUserData, (int64)index);
+
+        client.conn = SteamNetworkingSockets()->ConnectByIPAddress(_server_addr, 2, configs);
+        if (client.conn == k_HSteamNetConnection_Invalid)
+        {
+            client.state = client_state::closed;
+            ++_connect_failures;
+            return;
+        }
+
+        SteamNetworkingSockets()->SetConnectionPollGroup(client.conn, _poll_group);
+        _captured_clients[captured_conn] = index;
+    }
+
+    /// @brief Close the client as the capture did, after sending what's queued to it.
+    void close_client(replay_client& client)
+    {
+        flush_outgoing();
+        SteamNetworkingSockets()->CloseConnection(client.conn, 0, "Replay disconnect", true);
+        client.state = client_state::closed;
+        ++_disconnects;
+    }
+
+    /// @brief Callback that's called from the GNS when connection status changed.
+    /// As the GNS is on the manual poll mode, it's called on the loop, within `RunCallbacks()`.
+    static void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
+    {
+        if (_instance)
+            _instance->handle_status_change(*info);
+    }
+
+    void handle_status_change(const SteamNetConnectionStatusChangedCallback_t& info)
+    {
+        const auto index = (std::size_t)info.m_info.m_nUserData;
+        if (index >= _clients.size() || _clients[index].conn != info.m_hConn)
+            return;
+        replay_client& client = _clients[index];
+
+        switch (info.m_info.m_eState)
+        {
+        case k_ESteamNetworkingConnectionState_Connected:
+            if (client.state != client_state::connecting)
+                break;
+
+            client.state = client_state::connected;
+            ++_connects;
+
+            for (const auto& data : client.pending)
+                queue(client.conn, data);
+            client.pending.clear();
+
+            if (client.close_when_connected)
+                close_client(client);
+            break;
+
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally:
+            if (client.state == client_state::connected)
+                ++_lost_connections;
+            else if (client.state == client_state::connecting)
+                ++_connect_failures;
+
+            if (_lost_connections + _connect_failures <= 10)
+            {
+                std::cout << std::format("Client {}: {}, reason {}: {}", index,
+                                         info.m_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
+                                             ? "closed by peer"
+                                             : "problem detected locally",
+                                         info.m_info.m_eEndReason, info.m_info.m_szEndDebug)
+                          << std::endl;
+            }
+
+            _totals.skipped_messages += client.pending.size();
+            client.pending.clear();
+
+            SteamNetworkingSockets()->CloseConnection(client.conn, 0, nullptr, false);
+            client.state = client_state::closed;
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    /// @brief Queue a message to be sent with the others in `flush_outgoing()`.
+    void queue(HSteamNetConnection conn, const std::vector<std::byte>& data)
+    {
+        SteamNetworkingMessage_t* net_msg = SteamNetworkingUtils()->AllocateMessage((int)data.size());
+        if (!data.empty())
+            std::memcpy(net_msg->m_pData, data.data(), data.size());
+        net_msg->m_conn = conn;
+        net_msg->m_nFlags = k_nSteamNetworkingSend_ReliableNoNagle;
+        _outgoing_msgs.push_back(net_msg);
+
+        ++_totals.messages_sent;
+        _totals.bytes_sent += data.size();
+    }
+
+    /// @brief Submit all the queued messages with a single `SendMessages()` call.
+    void flush_outgoing()
+    {
+        if (_outgoing_msgs.empty())
+            return;
+
+        _message_numbers.resize(_outgoing_msgs.size());
+        SteamNetworkingSockets()->SendMessages((int)_outgoing_msgs.size(), _outgoing_msgs.data(),
+                                               _message_numbers.data());
+        for (const auto result : _message_numbers)
+            if (result < 0)
+                ++_totals.send_failures;
+
+        _outgoing_msgs.clear();
+    }
+
+    /// @brief Receive what the server sent, only to count it.
+    void receive_messages()
+    {
+        while (true)
+        {
+            const int received_msg_count = SteamNetworkingSockets()->ReceiveMessagesOnPollGroup(
+                _poll_group, _received_msgs.data(), MAX_MESSAGES_PER_RECEIVE);
+            if (received_msg_count == -1)
+                throw std::runtime_error("receive msg failed");
+
+            for (int i = 0; i < received_msg_count; ++i)
+            {
+                ++_totals.messages_received;
+                _totals.bytes_received += (std::uint64_t)_received_msgs[i]->m_cbSize;
+
+                _received_msgs[i]->Release();
+            }
+
+            if (received_msg_count < MAX_MESSAGES_PER_RECEIVE)
+                break;
+        }
+    }
+
+    void print_report(SteamNetworkingMicroseconds now)
+    {
+        const double seconds = (double)(now - _last_report_time) / 1'000'000.0;
+        const auto lag = _interval_lag_us.get_summary();
+
+        std::cout << std::format("[{:5.1f}s] Replayed {:.1f}s of capture, clients: {}, sent: {:.0f} msgs/s "
+                                 "({:.2f}MiB/s), received: {:.0f} msgs/s, lag p50/p99/max: {}/{}/{}us",
+                                 (double)(now - _start_time) / 1'000'000.0, (double)_replayed_time_us / 1'000'000.0,
+                                 _captured_clients.size(),
+                                 (double)(_totals.messages_sent - _reported_totals.messages_sent) / seconds,
+                                 (double)(_totals.bytes_sent - _reported_totals.bytes_sent) / seconds / (1024 * 1024),
+                                 (double)(_totals.messages_received - _reported_totals.messages_received) / seconds,
+                                 lag.p50, lag.p99, lag.max)
+                  << std::endl;
+
+        _interval_lag_us.reset();
+        _reported_totals = _totals;
+        _last_report_time = now;
+    }
+};
+
+int main(int argc, char** args)
+{
+    std::cout << "GNS-Practice #00: Chat" << std::endl;
+    std::cout << "Traffic replay in C++ with GameNetworkingSockets\n" << std::endl;
+
+    // Parse the capture, the server address and options from `args`
+    // Usage: chat_replay <capture> [host] [port] [--speed=<factor>|max]
+    std::string capture_path;
+    std::string_view host;
+    std::uint16_t port = chat_replay::DEFAULT_SERVER_PORT;
+    int positional_count = 0;
+    chat_replay::settings settings;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = args[i];
+        const std::string_view value = arg.substr(arg.find('=') + 1);
+
+        if (arg.starts_with("--speed="))
+        {
+            if (value == "max")
+                settings.speed = 0;
+            else if (!parse_double(value, settings.speed) || settings.speed <= 0)
+            {
+                std::cout << "Invalid speed: " << arg << std::endl;
+                return 0;
+            }
+        }
+        else if (positional_count == 0)
+        {
+            capture_path = arg;
+            ++positional_count;
+        }
+        else if (positional_count == 1)
+        {
+            host = arg;
+            ++positional_count;
+        }
+        else
+        {
+            long number;
+            if (!parse_long(arg, number) || number < 0 || number >= 65536)
+            {
+                std::cout << "Invalid port: " << arg << std::endl;
+                return 0;
+            }
+            port = (std::uint16_t)number;
+        }
+    }
+
+    if (capture_path.empty())
+    {
+        std::cout << "Usage: chat_replay <capture> [host] [port] [--speed=<factor>|max]" << std::endl;
+        return 0;
+    }
+
+    // Setup the address; only numeric addresses are supported, and an empty one is the local host
+    SteamNetworkingIPAddr server_addr{};
+    if (host.empty() || host == "localhost")
+    {
+        server_addr.SetIPv6LocalHost();
+    }
+    else if (!server_addr.ParseString(std::string(host).c_str()))
+    {
+        std::cout << "Invalid server address: " << host << std::endl;
+        return 0;
+    }
+    server_addr.m_port = port;
+
+    std::cout << std::format("Capture: {}, server addr: {}, port: {}, speed: {}\n", capture_path, host, port,
+                             settings.speed > 0 ? std::format("x{}", settings.speed) : "max")
+              << std::endl;
+
+    chat_replay replay;
+    if (!replay.start(capture_path, server_addr, settings))
+    {
+        std::cout << "Too bad..." << std::endl;
+        return 0;
+    }
+
+    replay.run();
+    replay.print_summary();
+    replay.dispose();
+}
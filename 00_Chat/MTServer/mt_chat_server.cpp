@@ -0,0 +1,789 @@
+// SPDX-License-Identifier: 0BSD
+
+#include "../Proto/ChatProtocol.pb.h"
+
+#include "../STServer/cli_args.hpp"
+#include "../STServer/connection_linger.hpp"
+#include "../STServer/logger.hpp"
+#include "../STServer/shared_payload.hpp"
+#include "../STServer/transport.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+class mt_chat_server
+{
+public:
+    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
+    static constexpr int MAX_MESSAGES_PER_RECEIVE = 100;
+
+    /// @brief Upper bound of a single blocking wait on the sockets.
+    static constexpr int MAX_POLL_WAIT_MILLISECONDS = 100;
+
+private:
+    struct client_info
+    {
+        std::string name;
+    };
+
+    /// @brief Shard event: A new client is assigned to the shard.
+    struct client_added
+    {
+        HSteamNetConnection conn;
+    };
+
+    /// @brief Shard event: A client of the shard is disconnected.
+    struct client_removed
+    {
+        HSteamNetConnection conn;
+        std::string reason;
+    };
+
+    /// @brief Shard event: Send a serialized chat to all clients of the shard, except `sender`.
+    struct broadcast
+    {
+        // Holds a reference, released once the event is handled
+        shared_payload* payload;
+        HSteamNetConnection sender;
+    };
+
+    using shard_event = std::variant<client_added, client_removed, broadcast>;
+
+    /// @brief A shard owns a poll group, and a worker thread that handles the messages received on it.
+    /// Connections are spread over the shards, so the relay work is spread over the worker threads.
+    struct shard
+    {
+        HSteamNetPollGroup poll_group = k_HSteamNetPollGroup_Invalid;
+        std::thread thread;
+
+        // Only touched by the worker thread of this shard.
+        std::unordered_map<std::uint32_t, client_info> clients;
+        std::vector<SteamNetworkingMessage_t*> outgoing_msgs;
+
+        // Events posted from other threads, and messages received on the poll group by the poll thread,
+        // handled on the worker thread of this shard.
+        std::mutex inbox_mutex;
+        std::vector<shard_event> inbox;
+        std::vector<SteamNetworkingMessage_t*> received_msgs;
+
+        // Bumped whenever there might be something to do on this shard.
+        std::atomic<std::uint32_t> wake_seq;
+
+        // Number of clients assigned to this shard, used to pick the least loaded shard.
+        std::atomic<std::size_t> client_count;
+    };
+
+private:
+    // Servers by their listen sockets, to route the connection status changed callbacks to the owner.
+    inline static std::mutex _servers_mutex;
+    inline static std::unordered_map<HSteamListenSocket, mt_chat_server*> _servers;
+
+    bool _disposed = true;
+
+    // Sockets the server runs on; the GNS, unless a benchmark puts a fake in.
+    transport& _transport;
+    bool _transport_acquired = false;
+
+    HSteamListenSocket _listen_socket = k_HSteamListenSocket_Invalid;
+
+    std::vector<std::unique_ptr<shard>> _shards;
+
+    // Which shard each connection is assigned to.
+    // Only touched by the poll thread (where the connection status changes are handled),
+    // or after all the threads have stopped.
+    std::unordered_map<std::uint32_t, std::size_t> _conn_shards;
+
+    // Connection status changes routed to this server, from whichever thread ran the callbacks.
+    // They're handled later on the poll thread.
+    std::mutex _status_changes_mutex;
+    std::vector<SteamNetConnectionStatusChangedCallback_t> _status_changes;
+    // Only touched by the poll thread, swapped with `_status_changes` to handle them outside of the lock.
+    std::vector<SteamNetConnectionStatusChangedCallback_t> _handling_status_changes;
+
+    // Last wake sequence of the sockets seen by the poll thread, or by `stop()` after it.
+    std::uint64_t _seen_wake_seq = 0;
+
+    std::atomic<bool> _quit_requested;
+    std::thread _poll_thread;
+
+public:
+    mt_chat_server() : mt_chat_server(gns_transport::shared())
+    {
+    }
+
+    /// @brief Make a server on the transport, e.g. `memory_transport` to run it without sockets.
+    explicit mt_chat_server(transport& server_transport) : _transport(server_transport)
+    {
+    }
+
+    // Callbacks are routed to this server by its address
+    mt_chat_server(const mt_chat_server&) = delete;
+    mt_chat_server& operator=(const mt_chat_server&) = delete;
+
+    ~mt_chat_server()
+    {
+        dispose();
+    }
+
+public:
+    /// @brief Start the server with specified port.
+    /// @param port Port to listen.
+    /// @param thread_count Number of worker threads, each with its own poll group.
+    /// @return Whether the server has been started to run, or errored.
+    bool start(std::uint16_t port, int thread_count)
+    {
+        if (thread_count <= 0)
+        {
+            logger::error("Failed to start mt_chat_server: invalid thread count {}", thread_count);
+            return false;
+        }
+
+        _disposed = false;
+
+        try
+        {
+            // Initialize `GameNetworkingSockets`, or share it with other servers in this process.
+            // The sockets are serviced from our own poll thread, instead of the GNS's internal service thread.
+            // This lets the poll thread block until something actually arrives, and wake the workers right away.
+            _transport.acquire();
+            _transport_acquired = true;
+
+            // Prepare shards, each with its own poll group
+            _conn_shards.clear();
+            for (int i = 0; i < thread_count; ++i)
+            {
+                auto& new_shard = *_shards.emplace_back(std::make_unique<shard>());
+                new_shard.poll_group = _transport.create_poll_group();
+                if (new_shard.poll_group == k_HSteamNetPollGroup_Invalid)
+                    throw std::runtime_error("Failed to create a poll group");
+            }
+
+            // Setup configuration used for listen socket
+            SteamNetworkingConfigValue_t configs[1]{};
+            configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                              (void*)dispatch_connection_status_changed);
+
+            {
+                // Callbacks can't run while we hold this,
+                // so no callback sees the listen socket before it's registered.
+                const auto polling_lock = _transport.lock_polling();
+
+                // Start listening
+                SteamNetworkingIPAddr addr{};
+                addr.m_port = port;
+                _listen_socket = _transport.create_listen_socket_ip(addr, 1, configs);
+                if (_listen_socket == k_HSteamListenSocket_Invalid)
+                {
+                    throw std::runtime_error("Failed to create a listen socket");
+                }
+
+                // Route the callbacks of the connections accepted from it to this server
+                std::lock_guard servers_lock(_servers_mutex);
+                _servers[_listen_socket] = this;
+            }
+
+            // Create the worker threads, and the poll thread
+            _quit_requested.store(false, std::memory_order_relaxed);
+            for (auto& each_shard : _shards)
+                each_shard->thread = std::thread(&mt_chat_server::worker_loop, this, std::ref(*each_shard));
+            _poll_thread = std::thread(&mt_chat_server::poll_loop, this);
+        }
+        catch (const std::exception& ex)
+        {
+            logger::error("Failed to start mt_chat_server: {}", ex.what());
+
+            dispose();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Stop the server.
+    /// @param linger_milliseconds Max milliseconds to wait for the connections to send what's queued to them,
+    /// e.g. a goodbye message, before dropping them. It returns as soon as they all have.
+    /// @return Number of connections that still had something to send when the wait was given up.
+    auto stop(int linger_milliseconds = 0) -> std::size_t
+    {
+        if (_disposed)
+            return 0;
+
+        logger::info("Stopping the server threads...");
+
+        // Stop the poll thread and the worker threads.
+        // Connections are closed after this, as `_conn_shards` is owned by the poll thread while it's running.
+        join_threads();
+
+        logger::info("Closing connections...");
+
+        std::vector<HSteamNetConnection> conns;
+        conns.reserve(_conn_shards.size());
+        for (const auto& conn_shard : _conn_shards)
+            conns.push_back(conn_shard.first);
+        const std::size_t unflushed =
+            connection_linger::close_when_flushed(_transport, _seen_wake_seq, std::move(conns), linger_milliseconds);
+
+        dispose();
+
+        return unflushed;
+    }
+
+    /// @brief Disposes the server synchronously.
+    /// If it was not stopped, it will block to stop.
+    void dispose()
+    {
+        if (!_disposed)
+        {
+            join_threads();
+
+            // This drops all connections accepted from it
+            if (_listen_socket != k_HSteamListenSocket_Invalid)
+            {
+                {
+                    std::lock_guard servers_lock(_servers_mutex);
+                    _servers.erase(_listen_socket);
+                }
+
+                _transport.close_listen_socket(_listen_socket);
+                _listen_socket = k_HSteamListenSocket_Invalid;
+            }
+
+            _conn_shards.clear();
+
+            {
+                std::lock_guard status_changes_lock(_status_changes_mutex);
+                _status_changes.clear();
+            }
+
+            for (auto& each_shard : _shards)
+            {
+                // Release the payloads of the broadcasts that weren't handled
+                for (auto& event : each_shard->inbox)
+                {
+                    if (auto* ev = std::get_if<broadcast>(&event))
+                        ev->payload->release();
+                }
+                each_shard->inbox.clear();
+
+                for (auto* msg : each_shard->received_msgs)
+                    msg->Release();
+                each_shard->received_msgs.clear();
+
+                if (each_shard->poll_group != k_HSteamNetPollGroup_Invalid)
+                    _transport.destroy_poll_group(each_shard->poll_group);
+            }
+            _shards.clear();
+
+            if (_transport_acquired)
+            {
+                _transport.release();
+                _transport_acquired = false;
+            }
+
+            _disposed = true;
+        }
+    }
+
+private:
+    /// @brief Request all the threads to quit, and wait for them.
+    void join_threads()
+    {
+        _quit_requested.store(true, std::memory_order_relaxed);
+
+        // Don't let the poll thread wait out its timeout
+        _transport.wake();
+        if (_poll_thread.joinable())
+            _poll_thread.join();
+
+        for (auto& each_shard : _shards)
+        {
+            wake(*each_shard);
+            if (each_shard->thread.joinable())
+                each_shard->thread.join();
+        }
+    }
+
+    /// @brief Wake the worker thread of the shard, if it's waiting.
+    static void wake(shard& target)
+    {
+        target.wake_seq.fetch_add(1, std::memory_order_release);
+        target.wake_seq.notify_one();
+    }
+
+    /// @brief Post an event to the shard, which is handled on its worker thread.
+    static void post(shard& target, shard_event&& event)
+    {
+        {
+            std::lock_guard lock(target.inbox_mutex);
+            target.inbox.push_back(std::move(event));
+        }
+        wake(target);
+    }
+
+    /// @brief Wait on the sockets and handle the connection status changes here,
+    /// then hand the received messages over to the workers of their shards.
+    void poll_loop()
+    {
+        SteamNetworkingMessage_t* msgs[MAX_MESSAGES_PER_RECEIVE];
+        bool more_to_receive = false;
+
+        while (!_quit_requested.load(std::memory_order_relaxed))
+        {
+            // Block until the sockets have something for us, or a GNS timer is due.
+            // This thread might be the one running the callbacks of all the servers, or another server's might be.
+            // If a poll group had more than we took last time, don't wait at all.
+            _transport.wait(_seen_wake_seq, more_to_receive ? 0 : MAX_POLL_WAIT_MILLISECONDS);
+
+            // Either way, the connection status changes of this server are handled on this thread only.
+            handle_status_changes();
+
+            // Receive here rather than on the workers, so that only the shards that got messages are woken up,
+            // instead of all of them on every wake-up of the sockets.
+            // A client is posted to the shard before it's assigned to the poll group,
+            // so the shard has the event of every client it receives from before the messages.
+            more_to_receive = false;
+            for (auto& each_shard : _shards)
+            {
+                const int received_msg_count =
+                    _transport.receive_messages_on_poll_group(each_shard->poll_group, msgs, MAX_MESSAGES_PER_RECEIVE);
+                if (received_msg_count == -1)
+                {
+                    throw std::runtime_error("receive msg failed");
+                }
+                if (received_msg_count == 0)
+                    continue;
+
+                {
+                    std::lock_guard lock(each_shard->inbox_mutex);
+                    each_shard->received_msgs.insert(each_shard->received_msgs.end(), msgs,
+                                                     msgs + received_msg_count);
+                }
+                wake(*each_shard);
+
+                more_to_receive |= (received_msg_count == MAX_MESSAGES_PER_RECEIVE);
+            }
+        }
+    }
+
+    /// @brief Handle the events and the received messages of the shard.
+    /// @param self Shard owned by this worker thread.
+    void worker_loop(shard& self)
+    {
+        std::vector<shard_event> events;
+        std::vector<SteamNetworkingMessage_t*> msgs;
+
+        while (!_quit_requested.load(std::memory_order_relaxed))
+        {
+            const std::uint32_t seen_wake_seq = self.wake_seq.load(std::memory_order_acquire);
+
+            {
+                std::lock_guard lock(self.inbox_mutex);
+                events.swap(self.inbox);
+                msgs.swap(self.received_msgs);
+            }
+            const bool did_work = !events.empty() || !msgs.empty();
+
+            // Handle the events BEFORE the messages, so that every client we received from is added here.
+            for (auto& event : events)
+                std::visit([this, &self](auto& ev) { on_event(self, ev); }, event);
+            events.clear();
+
+            for (auto* msg : msgs)
+            {
+                on_message(self, *msg);
+
+                msg->Release();
+            }
+            msgs.clear();
+
+            // Wait until the poll thread or another shard wakes us up.
+            if (!did_work)
+                self.wake_seq.wait(seen_wake_seq, std::memory_order_acquire);
+        }
+    }
+
+    void on_event(shard& self, client_added& ev)
+    {
+        self.clients.try_emplace(ev.conn, client_info{});
+
+        logger::info("New client #{} connected!", ev.conn);
+    }
+
+    void on_event(shard& self, client_removed& ev)
+    {
+        auto it = self.clients.find(ev.conn);
+        if (it == self.clients.end())
+            return;
+
+        std::string_view client_name = "(not logged-in client)";
+        if (!it->second.name.empty())
+            client_name = it->second.name;
+        logger::info("{} {}", client_name, ev.reason);
+
+        self.clients.erase(it);
+        self.client_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void on_event(shard& self, broadcast& ev)
+    {
+        send_to_shard(self, *ev.payload, ev.sender);
+        ev.payload->release();
+    }
+
+    /// @brief Send the payload to all clients of the shard except `sender`, without copying it for each one.
+    void send_to_shard(shard& self, shared_payload& payload, HSteamNetConnection sender)
+    {
+        self.outgoing_msgs.clear();
+        for (const auto& client : self.clients)
+        {
+            const auto conn = client.first;
+
+            // Ignore the sender
+            if (conn != sender)
+            {
+                // Allocate a message without its own buffer, and point it to the shared payload
+                SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+                payload.attach(*msg, conn, k_nSteamNetworkingSend_ReliableNoNagle);
+                self.outgoing_msgs.push_back(msg);
+            }
+        }
+
+        // Submit them all at once
+        if (!self.outgoing_msgs.empty())
+            _transport.send_messages((int)self.outgoing_msgs.size(), self.outgoing_msgs.data());
+        self.outgoing_msgs.clear();
+    }
+
+    /// @brief Send the payload to a single client, without copying it.
+    void send(shared_payload& payload, HSteamNetConnection conn)
+    {
+        SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+        payload.attach(*msg, conn, k_nSteamNetworkingSend_ReliableNoNagle);
+        _transport.send_messages(1, &msg);
+    }
+
+    /// @brief Serialize the message into a payload, with a single reference owned by the caller.
+    static auto serialize(const GNSPrac::Chat::ChatProtocol& msg) -> shared_payload*
+    {
+        const std::uint32_t size = (std::uint32_t)msg.ByteSizeLong();
+        shared_payload* payload = shared_payload::create(size);
+        msg.SerializeToArray(payload->data(), (int)size);
+        return payload;
+    }
+
+    /// @brief Pick the shard with the fewest clients.
+    auto pick_shard() const -> std::size_t
+    {
+        std::size_t picked = 0;
+        std::size_t picked_count = SIZE_MAX;
+        for (std::size_t i = 0; i < _shards.size(); ++i)
+        {
+            const std::size_t count = _shards[i]->client_count.load(std::memory_order_relaxed);
+            if (count < picked_count)
+            {
+                picked = i;
+                picked_count = count;
+            }
+        }
+        return picked;
+    }
+
+    /// @brief Callback that's called from the GNS when connection status changed for any client of any server.
+    /// This function is static, due to GNS's callbacks using function pointers,
+    /// so it routes the callback to the server owning the listen socket the connection was accepted from.
+    ///
+    /// It's called on whichever thread is polling the sockets in `transport::wait()`,
+    /// which might not be the poll thread of the owner, so the owner handles it later on its own poll thread.
+    /// @param info Connection status changed info.
+    static void dispatch_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
+    {
+        std::unique_lock servers_lock(_servers_mutex);
+
+        auto it = _servers.find(info->m_info.m_hListenSocket);
+        if (it == _servers.end())
+        {
+            servers_lock.unlock();
+
+            // The owner is already gone, so just clean up the connection
+            if (info->m_info.m_eState != k_ESteamNetworkingConnectionState_None)
+                gns_transport::shared().close_connection(info->m_hConn, 0, "Server shutdown", false);
+            return;
+        }
+
+        mt_chat_server& server = *it->second;
+        std::lock_guard status_changes_lock(server._status_changes_mutex);
+        server._status_changes.push_back(*info);
+    }
+
+    /// @brief Handle the connection status changes routed to this server.
+    void handle_status_changes()
+    {
+        {
+            std::lock_guard status_changes_lock(_status_changes_mutex);
+            _handling_status_changes.swap(_status_changes);
+        }
+
+        for (auto& info : _handling_status_changes)
+            on_connection_status_changed(info);
+        _handling_status_changes.clear();
+    }
+
+    /// @brief Called on the poll thread when connection status changed for a client of this server.
+    /// @param info Connection status changed info.
+    void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t& info)
+    {
+        switch (info.m_info.m_eState)
+        {
+        case k_ESteamNetworkingConnectionState_None:
+            // This is when you destroy the connection.
+            // Nothing to do here.
+            break;
+
+        case k_ESteamNetworkingConnectionState_Connecting: {
+
+            // Accept the connection.
+            EResult accept_result = _transport.accept_connection(info.m_hConn);
+
+            // If accept failed, clean up the connection.
+            if (accept_result != k_EResultOK)
+            {
+                _transport.close_connection(info.m_hConn, 0, "Accept failure", false);
+                logger::error("Accept failed with {}", (int)accept_result);
+                break;
+            }
+
+            // Pick a shard for the new client, and add it there.
+            //
+            // Note that we do this BEFORE assign it to the poll group,
+            // so that the worker thread of the shard always knows the client of the messages it handles.
+            const std::size_t shard_idx = pick_shard();
+            shard& picked = *_shards[shard_idx];
+            _conn_shards.try_emplace(info.m_hConn, shard_idx);
+            picked.client_count.fetch_add(1, std::memory_order_relaxed);
+            post(picked, client_added{info.m_hConn});
+
+            // Assign new client to the poll group of the shard
+            if (!_transport.set_connection_poll_group(info.m_hConn, picked.poll_group))
+            {
+                _conn_shards.erase(info.m_hConn);
+                post(picked, client_removed{info.m_hConn, "(poll group assign failure)"});
+                _transport.close_connection(info.m_hConn, 0, "Poll group assign failure", false);
+
+                logger::error("Failed to assign poll group");
+                break;
+            }
+
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally: {
+            // Connection changed callbacks are dispatched in FIFO order.
+
+            // Build the reason of connection close
+            SteamNetConnectionInfo_t& conn_info = info.m_info;
+            std::string_view state = conn_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
+                                         ? "closed by peer"
+                                         : "problem detected locally";
+            char addr_str[SteamNetworkingIPAddr::k_cchMaxString];
+            conn_info.m_addrRemote.ToString(addr_str, sizeof addr_str, true);
+            std::string reason = std::format("({}) {} ({}), reason {}: {}", addr_str,
+                                             conn_info.m_szConnectionDescription, state, conn_info.m_eEndReason,
+                                             conn_info.m_szEndDebug);
+
+            // Remove it from its shard, which logs the reason with the client name
+            auto it = _conn_shards.find(info.m_hConn);
+            if (it != _conn_shards.end())
+            {
+                post(*_shards[it->second], client_removed{info.m_hConn, std::move(reason)});
+                _conn_shards.erase(it);
+            }
+
+            // Don't forget to clean up the connection!
+            _transport.close_connection(info.m_hConn, 0, nullptr, false);
+
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_Connected:
+            // Callback after accepting the connection.
+            // Nothing to do here, as we're the server.
+            break;
+        }
+    }
+
+    /// @brief Callback that's called when a message arrived from a client of the shard.
+    void on_message(shard& self, const SteamNetworkingMessage_t& net_msg)
+    {
+        // Ignore the empty message.
+        if (net_msg.m_cbSize == 0)
+        {
+            logger::warning("Client sent an empty message");
+            return;
+        }
+
+        // Unmarshall the protobuf message
+        GNSPrac::Chat::ChatProtocol msg;
+        if (!msg.ParseFromArray(net_msg.m_pData, net_msg.m_cbSize))
+        {
+            logger::warning("Client sent an invalid message");
+            return;
+        }
+
+        // Get the client from the shard.
+        // It might have been removed already, if it's disconnected after sending this.
+        auto it = self.clients.find(net_msg.m_conn);
+        if (it == self.clients.end())
+            return;
+        client_info& client = it->second;
+
+        // Handle the message based on its type
+        switch (msg.msg_case())
+        {
+            using msg_case = GNSPrac::Chat::ChatProtocol::MsgCase;
+
+        case msg_case::kChat: {
+            GNSPrac::Chat::ChatProtocol response;
+            auto& chat = *response.mutable_chat();
+            *chat.mutable_sender_name() = client.name.empty() ? std::format("Guest#{}", net_msg.m_conn) : client.name;
+            *chat.mutable_content() = msg.chat().content();
+
+            // Serialize the response once, and share it with the other shards without copying it.
+            shared_payload* payload = serialize(response);
+
+            // Propagate the response to the clients of this shard right away,
+            // and to the clients of other shards on their own worker threads.
+            send_to_shard(self, *payload, net_msg.m_conn);
+            for (auto& other_shard : _shards)
+            {
+                if (other_shard.get() != &self)
+                {
+                    payload->add_ref();
+                    post(*other_shard, broadcast{payload, net_msg.m_conn});
+                }
+            }
+            payload->release();
+
+            // Log the chat message on the server side, too.
+            logger::info("{}: {}", response.chat().sender_name(), response.chat().content());
+            break;
+        }
+
+        case msg_case::kNameChange: {
+            // Set the new name if not null
+            if (msg.has_name_change() && !msg.name_change().name().empty())
+            {
+                client.name = msg.name_change().name();
+                logger::info("Client #{} changed their name to {}", net_msg.m_conn, client.name);
+            }
+
+            // Prepare the response to the client about their current name
+            GNSPrac::Chat::ChatProtocol response;
+            auto& chat = *response.mutable_chat();
+            *chat.mutable_sender_name() = "Server";
+            *chat.mutable_content() = std::format(
+                "Your name is now {}", client.name.empty() ? std::format("Guest#{}", net_msg.m_conn) : client.name);
+
+            // Notify to the client about their current name
+            shared_payload* payload = serialize(response);
+            send(*payload, net_msg.m_conn);
+            payload->release();
+            break;
+        }
+
+        default:
+            // Client shouldn't send other type of messages
+            logger::warning("Client sent an invalid message type: {}", (int)msg.msg_case());
+            break;
+        }
+    }
+};
+
+int main(int argc, char** args)
+{
+    std::cout << "GNS-Practice #00: Chat" << std::endl;
+    std::cout << "Multi-threaded chat server in C++ with GameNetworkingSockets\n" << std::endl;
+
+    // Parse port and options from `args`
+    // Usage: mt_chat_server [port] [--threads=<worker threads>]
+    std::uint16_t port = mt_chat_server::DEFAULT_SERVER_PORT;
+    int thread_count = (int)std::max(1u, std::thread::hardware_concurrency());
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = args[i];
+
+        if (arg.starts_with("--threads="))
+        {
+            long parsed_threads;
+            if (!parse_long(arg.substr(arg.find('=') + 1), parsed_threads) || parsed_threads <= 0 ||
+                parsed_threads > 1024)
+            {
+                std::cout << "Invalid thread count: " << arg << std::endl;
+                return 0;
+            }
+            thread_count = (int)parsed_threads;
+        }
+        else
+        {
+            long parsed_port;
+            if (!parse_long(arg, parsed_port) || parsed_port < 0 || parsed_port >= 65536)
+            {
+                std::cout << "Invalid port: " << arg << std::endl;
+                return 0;
+            }
+            port = (std::uint16_t)parsed_port;
+        }
+    }
+
+    std::cout << "Server port: " << port << '\n' << std::endl;
+    std::cout << "Worker threads: " << thread_count << '\n' << std::endl;
+
+    // Start the server with specified port
+    mt_chat_server server;
+    if (!server.start(port, thread_count))
+    {
+        std::cout << "Too bad..." << std::endl;
+        return 0;
+    }
+
+    std::cout << "Server started, type /quit to quit" << std::endl;
+
+    while (true)
+    {
+        std::string message;
+        std::getline(std::cin, message);
+
+        if (message.empty())
+            continue;
+
+        if (message == "/quit")
+            break;
+    }
+
+    // Let's quit the server now!
+
+    // Stop the server, giving it up to 2 seconds to flush what's queued to the clients
+    server.stop(2000);
+
+    std::cout << "Server closed!" << std::endl;
+}
@@ -20,6 +20,9 @@ public class STChatServer : IAsyncDisposable, IDisposable
 
     private const int MaxMessagePerReceive = 100;
 
+    private const int MaxRoomNameLength = 64;
+    private const int MaxRoomsPerClient = 16;
+
     private bool disposed;
 
     private IntPtr gnsLib;
@@ -30,6 +33,7 @@ public class STChatServer : IAsyncDisposable, IDisposable
     private uint listenSocket;
 
     private Dictionary<uint, ClientInfo>? clients;
+    private Dictionary<string, HashSet<uint>>? rooms;
 
     private Task? serverTask;
     private CancellationTokenSource? cancelTokenSrc;
@@ -113,6 +117,10 @@ public class STChatServer : IAsyncDisposable, IDisposable
             // Note that a client might not logged in yet.
             this.clients = [];
 
+            // Members of each room, by its name.
+            // A room is created when someone joins it, and removed when the last member leaves it.
+            this.rooms = [];
+
             // Setup the connection status changed callback delegate instance.
             // This delegate instance should live until the server is closed, because it's called from native dll.
             this.ConnectionStatusChanged = new(this.OnConnectionStatusChanged);
@@ -267,6 +275,7 @@ public class STChatServer : IAsyncDisposable, IDisposable
             {
                 this.ConnectionStatusChanged = null;
                 this.clients = null;
+                this.rooms = null;
             }
 
             // unmanaged
@@ -326,6 +335,7 @@ public class STChatServer : IAsyncDisposable, IDisposable
 
             this.ConnectionStatusChanged = null;
             this.clients = null;
+            this.rooms = null;
 
             this.netSockets?.Dispose();
             this.netSockets = null;
@@ -517,7 +527,12 @@ public class STChatServer : IAsyncDisposable, IDisposable
 
                 Console.WriteLine($"{clientName} ({connInfo.m_addrRemote}) {desc ?? "(Invalid desc)"} ({state}), reason {connInfo.m_eEndReason}: {dbg ?? "(Invalid dbg)"}");
 
-                // Remove it from the clients dictionary
+                // Remove it from the rooms it has joined, and from the clients dictionary
+                foreach (string roomName in client.Rooms)
+                {
+                    this.RemoveRoomMember(roomName, info.m_hConn);
+                }
+
                 this.clients.Remove(info.m_hConn);
 
                 // Don't forget to clean up the connection!
@@ -563,6 +578,15 @@ public class STChatServer : IAsyncDisposable, IDisposable
         {
             case ChatProtocol.MsgOneofCase.Chat:
                 {
+                    // A chat to a room goes only to its members, and only a member can send to it
+                    string roomName = msg.Chat.Room ?? string.Empty;
+                    HashSet<uint>? roomMembers = null;
+                    if (roomName.Length != 0 && (!client.Rooms.Contains(roomName) || !this.rooms!.TryGetValue(roomName, out roomMembers)))
+                    {
+                        this.SendServerNotice(netMsg.m_conn, $"You're not in the room {roomName}");
+                        break;
+                    }
+
                     // We could reuse the same `msg`, but we'll just create another one to demonstrate.
                     ChatProtocol response = new()
                     {
@@ -570,6 +594,7 @@ public class STChatServer : IAsyncDisposable, IDisposable
                         {
                             SenderName = client.Name ?? $"Guest#{netMsg.m_conn}",
                             Content = msg.Chat.Content,
+                            Room = roomName,
                         },
                     };
 
@@ -578,8 +603,8 @@ public class STChatServer : IAsyncDisposable, IDisposable
                     MemoryStream responseMS = new();
                     ProtoBuf.Serializer.Serialize(responseMS, response);
 
-                    // Propagate the response to other clients.
-                    foreach (var otherClientConn in this.clients.Keys)
+                    // Propagate the response to other clients, or to other members of the room.
+                    foreach (var otherClientConn in (IEnumerable<uint>?)roomMembers ?? this.clients.Keys)
                     {
                         // Ignore itself
                         if (otherClientConn != netMsg.m_conn)
@@ -589,7 +614,66 @@ public class STChatServer : IAsyncDisposable, IDisposable
                     }
 
                     // Print the chat message on the server side, too.
-                    Console.WriteLine($"{response.Chat.SenderName}: {response.Chat.Content}");
+                    if (roomName.Length != 0)
+                    {
+                        Console.WriteLine($"[{roomName}] {response.Chat.SenderName}: {response.Chat.Content}");
+                    }
+                    else
+                    {
+                        Console.WriteLine($"{response.Chat.SenderName}: {response.Chat.Content}");
+                    }
+
+                    break;
+                }
+
+            case ChatProtocol.MsgOneofCase.JoinRoom:
+                {
+                    string roomName = msg.JoinRoom.Room ?? string.Empty;
+                    if (roomName.Length == 0 || Encoding.UTF8.GetByteCount(roomName) > MaxRoomNameLength)
+                    {
+                        this.SendServerNotice(netMsg.m_conn, "Invalid room name");
+                        break;
+                    }
+
+                    if (client.Rooms.Contains(roomName))
+                    {
+                        this.SendServerNotice(netMsg.m_conn, $"You're already in the room {roomName}");
+                        break;
+                    }
+
+                    if (client.Rooms.Count >= MaxRoomsPerClient)
+                    {
+                        this.SendServerNotice(netMsg.m_conn, $"You can't join more than {MaxRoomsPerClient} rooms");
+                        break;
+                    }
+
+                    client.Rooms.Add(roomName);
+                    if (!this.rooms!.TryGetValue(roomName, out HashSet<uint>? members))
+                    {
+                        members = [];
+                        this.rooms.Add(roomName, members);
+                    }
+
+                    members.Add(netMsg.m_conn);
+
+                    Console.WriteLine($"Client #{netMsg.m_conn} joined the room {roomName}");
+                    this.SendServerNotice(netMsg.m_conn, $"You joined the room {roomName}");
+                    break;
+                }
+
+            case ChatProtocol.MsgOneofCase.LeaveRoom:
+                {
+                    string roomName = msg.LeaveRoom.Room ?? string.Empty;
+                    if (!client.Rooms.Remove(roomName))
+                    {
+                        this.SendServerNotice(netMsg.m_conn, $"You're not in the room {roomName}");
+                        break;
+                    }
+
+                    this.RemoveRoomMember(roomName, netMsg.m_conn);
+
+                    Console.WriteLine($"Client #{netMsg.m_conn} left the room {roomName}");
+                    this.SendServerNotice(netMsg.m_conn, $"You left the room {roomName}");
                     break;
                 }
 
@@ -602,23 +686,8 @@ public class STChatServer : IAsyncDisposable, IDisposable
                         Console.WriteLine($"Client #{netMsg.m_conn} changed their name to {client.Name}");
                     }
 
-                    // Prepare the response to the client about their current name
-                    ChatProtocol response = new()
-                    {
-                        Chat = new()
-                        {
-                            SenderName = "Server",
-                            Content = $"Your name is now {client.Name ?? $"Guest#{netMsg.m_conn}"}",
-                        },
-                    };
-
-                    // Serialize the response to a memory stream.
-                    // In real use case, you would get this from a pool.
-                    MemoryStream responseMS = new();
-                    ProtoBuf.Serializer.Serialize(responseMS, response);
-
                     // Notify to the client about their current name
-                    this.netSockets!.SendMessageToConnection(netMsg.m_conn, responseMS.GetBuffer(), Convert.ToUInt32(responseMS.Position), Native.k_nSteamNetworkingSend_ReliableNoNagle, out Unsafe.NullRef<long>());
+                    this.SendServerNotice(netMsg.m_conn, $"Your name is now {client.Name ?? $"Guest#{netMsg.m_conn}"}");
                     break;
                 }
 
@@ -629,8 +698,54 @@ public class STChatServer : IAsyncDisposable, IDisposable
         }
     }
 
+    /// <summary>
+    /// Send a chat from the server to a single client.
+    /// </summary>
+    /// <param name="conn">Connection of the client.</param>
+    /// <param name="content">Content of the chat.</param>
+    private void SendServerNotice(uint conn, string content)
+    {
+        ChatProtocol notice = new()
+        {
+            Chat = new()
+            {
+                SenderName = "Server",
+                Content = content,
+            },
+        };
+
+        // Serialize the notice to a memory stream.
+        // In real use case, you would get this from a pool.
+        MemoryStream noticeMS = new();
+        ProtoBuf.Serializer.Serialize(noticeMS, notice);
+
+        this.netSockets!.SendMessageToConnection(conn, noticeMS.GetBuffer(), Convert.ToUInt32(noticeMS.Position), Native.k_nSteamNetworkingSend_ReliableNoNagle, out Unsafe.NullRef<long>());
+    }
+
+    /// <summary>
+    /// Remove the client from the members of the room, and remove the room if it's left empty.
+    /// </summary>
+    /// <param name="roomName">Name of the room.</param>
+    /// <param name="conn">Connection of the client.</param>
+    private void RemoveRoomMember(string roomName, uint conn)
+    {
+        if (this.rooms!.TryGetValue(roomName, out HashSet<uint>? members))
+        {
+            members.Remove(conn);
+            if (members.Count == 0)
+            {
+                this.rooms.Remove(roomName);
+            }
+        }
+    }
+
     private class ClientInfo
     {
         public string? Name { get; set; }
+
+        /// <summary>
+        /// Gets the rooms this client has joined.
+        /// </summary>
+        public HashSet<string> Rooms { get; } = [];
     }
 }
@@ -0,0 +1,28 @@
+// SPDX-License-Identifier: 0BSD
+
+// Replaces the global `operator new` to count the heap allocations into `t_allocation_count`.
+// Linked only into `chat_bench`, and into `st_chat_server` with `CHAT_COUNT_ALLOCATIONS`.
+
+#include "allocation_counter.hpp"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+void* operator new(std::size_t size)
+{
+    ++t_allocation_count;
+    if (void* ptr = std::malloc(size ? size : 1))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
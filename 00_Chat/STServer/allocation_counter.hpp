@@ -0,0 +1,10 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <cstdint>
+
+/// @brief Heap allocations made on this thread, to report how many allocations handling a message takes.
+/// Only the executables linking `allocation_counter.cpp` count them, in its replaced `operator new`;
+/// otherwise, this stays zero.
+inline thread_local std::uint64_t t_allocation_count = 0;
@@ -0,0 +1,168 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+
+/// @brief Size-class buffer pool for the serialized outgoing messages.
+///
+/// Buffers are rounded up to a power of two from `MIN_BLOCK_SIZE` to `MAX_BLOCK_SIZE`,
+/// and recycled through a free list per size class instead of going back to the heap.
+/// Larger buffers are not pooled, and always come from the heap.
+///
+/// This is thread-safe, as GNS frees the sent messages on whichever thread it's running.
+class buffer_pool
+{
+public:
+    static constexpr std::size_t MIN_BLOCK_SIZE = 64;
+    static constexpr std::size_t MAX_BLOCK_SIZE = 64 * 1024;
+    static constexpr std::size_t SIZE_CLASS_COUNT =
+        std::countr_zero(MAX_BLOCK_SIZE) - std::countr_zero(MIN_BLOCK_SIZE) + 1;
+
+    struct stats
+    {
+        /// @brief Allocations served from a free list.
+        std::uint64_t hits;
+        /// @brief Allocations that had to go to the heap, because the free list was empty.
+        std::uint64_t misses;
+        /// @brief Allocations larger than `MAX_BLOCK_SIZE`, which are never pooled.
+        std::uint64_t oversized;
+        /// @brief Buffers currently handed out.
+        std::uint64_t in_use;
+        /// @brief Max number of buffers handed out at once.
+        std::uint64_t high_water;
+    };
+
+private:
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    struct size_class
+    {
+        std::mutex mutex;
+        free_block* head = nullptr;
+    };
+
+private:
+    std::array<size_class, SIZE_CLASS_COUNT> _size_classes;
+
+    std::atomic<std::uint64_t> _hits{0};
+    std::atomic<std::uint64_t> _misses{0};
+    std::atomic<std::uint64_t> _oversized{0};
+    std::atomic<std::uint64_t> _in_use{0};
+    std::atomic<std::uint64_t> _high_water{0};
+
+public:
+    buffer_pool() = default;
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    ~buffer_pool()
+    {
+        for (auto& cls : _size_classes)
+        {
+            while (cls.head)
+            {
+                free_block* block = cls.head;
+                cls.head = block->next;
+                ::operator delete(block);
+            }
+        }
+    }
+
+    /// @brief Pool shared by all the servers in this process.
+    /// It outlives the servers, as GNS might free the sent messages after a server is gone.
+    static auto shared() -> buffer_pool&
+    {
+        static buffer_pool pool;
+        return pool;
+    }
+
+public:
+    /// @brief Allocate a buffer of at least `size` bytes.
+    auto allocate(std::size_t size) -> void*
+    {
+        add_in_use();
+
+        if (size > MAX_BLOCK_SIZE)
+        {
+            _oversized.fetch_add(1, std::memory_order_relaxed);
+            return ::operator new(size);
+        }
+
+        const std::size_t cls_idx = size_class_index(size);
+        auto& cls = _size_classes[cls_idx];
+        {
+            std::lock_guard lock(cls.mutex);
+            if (free_block* block = cls.head)
+            {
+                cls.head = block->next;
+                _hits.fetch_add(1, std::memory_order_relaxed);
+                return block;
+            }
+        }
+
+        _misses.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(MIN_BLOCK_SIZE << cls_idx);
+    }
+
+    /// @brief Return a buffer to the pool.
+    /// @param buffer Buffer allocated with `allocate()`.
+    /// @param size The same `size` passed to `allocate()`.
+    void deallocate(void* buffer, std::size_t size)
+    {
+        _in_use.fetch_sub(1, std::memory_order_relaxed);
+
+        if (size > MAX_BLOCK_SIZE)
+        {
+            ::operator delete(buffer);
+            return;
+        }
+
+        auto& cls = _size_classes[size_class_index(size)];
+        auto* block = new (buffer) free_block{};
+
+        std::lock_guard lock(cls.mutex);
+        block->next = cls.head;
+        cls.head = block;
+    }
+
+    auto get_stats() const -> stats
+    {
+        return stats{
+            .hits = _hits.load(std::memory_order_relaxed),
+            .misses = _misses.load(std::memory_order_relaxed),
+            .oversized = _oversized.load(std::memory_order_relaxed),
+            .in_use = _in_use.load(std::memory_order_relaxed),
+            .high_water = _high_water.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    static auto size_class_index(std::size_t size) -> std::size_t
+    {
+        if (size <= MIN_BLOCK_SIZE)
+            return 0;
+        return std::bit_width(size - 1) - std::countr_zero(MIN_BLOCK_SIZE);
+    }
+
+    void add_in_use()
+    {
+        const std::uint64_t in_use = _in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+
+        std::uint64_t high_water = _high_water.load(std::memory_order_relaxed);
+        while (in_use > high_water &&
+               !_high_water.compare_exchange_weak(high_water, in_use, std::memory_order_relaxed))
+        {
+        }
+    }
+};
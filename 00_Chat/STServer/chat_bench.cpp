@@ -0,0 +1,437 @@
+// SPDX-License-Identifier: 0BSD
+
+// Microbenchmarks of the message handling path of `st_chat_server`, with Google Benchmark.
+//
+// The results are written to `chat_bench.json` as well as the console, to compare them release to release;
+// `--benchmark_out=<path>` writes them elsewhere, and the other `--benchmark_*` flags work as usual.
+
+#include "../Proto/ChatProtocol.pb.h"
+
+#include "client_registry.hpp"
+#include "memory_transport.hpp"
+#include "st_chat_server.hpp"
+
+#include <benchmark/benchmark.h>
+#include <google/protobuf/arena.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief Port of the benchmarked servers; nothing listens on it, as they're on `memory_transport`.
+static constexpr std::uint16_t BENCH_PORT = st_chat_server::DEFAULT_SERVER_PORT;
+
+/// @brief Registry of the server's clients, with the real size and layout of its `client_info`.
+using bench_registry = st_chat_server::registry_type;
+
+/// @brief Handle of the `i`-th connection `memory_transport` would accept.
+static auto bench_connection(std::size_t i) -> HSteamNetConnection
+{
+    return (HSteamNetConnection)(memory_transport::FIRST_HANDLE + i);
+}
+
+static auto make_chat(std::size_t content_size) -> GNSPrac::Chat::ChatProtocol
+{
+    GNSPrac::Chat::ChatProtocol msg;
+    auto* chat = msg.mutable_chat();
+    chat->set_sender_name(std::format("Guest#{}", memory_transport::FIRST_HANDLE));
+    chat->set_content(std::string(content_size, 'x'));
+    return msg;
+}
+
+static void bench_serialize_chat(benchmark::State& state)
+{
+    const auto msg = make_chat((std::size_t)state.range(0));
+    std::string bytes;
+
+    for (auto _ : state)
+    {
+        msg.SerializeToString(&bytes);
+        benchmark::DoNotOptimize(bytes.data());
+    }
+
+    state.SetBytesProcessed((std::int64_t)state.iterations() * (std::int64_t)bytes.size());
+}
+
+static void bench_parse_chat(benchmark::State& state)
+{
+    const std::string bytes = make_chat((std::size_t)state.range(0)).SerializeAsString();
+    GNSPrac::Chat::ChatProtocol msg;
+
+    for (auto _ : state)
+    {
+        if (!msg.ParseFromArray(bytes.data(), (int)bytes.size()))
+            state.SkipWithError("Failed to parse");
+        benchmark::DoNotOptimize(msg.chat().content().data());
+    }
+
+    state.SetBytesProcessed((std::int64_t)state.iterations() * (std::int64_t)bytes.size());
+}
+
+/// @brief Parse into a message on an arena reset every time, like the server does with `use_protobuf_arena`.
+static void bench_parse_chat_arena(benchmark::State& state)
+{
+    const std::string bytes = make_chat((std::size_t)state.range(0)).SerializeAsString();
+    std::vector<char> initial_block(st_chat_server::ARENA_INITIAL_BLOCK_SIZE);
+    google::protobuf::Arena arena(initial_block.data(), initial_block.size());
+
+    for (auto _ : state)
+    {
+        auto* msg = google::protobuf::Arena::CreateMessage<GNSPrac::Chat::ChatProtocol>(&arena);
+        if (!msg->ParseFromArray(bytes.data(), (int)bytes.size()))
+            state.SkipWithError("Failed to parse");
+        benchmark::DoNotOptimize(msg->chat().content().data());
+        arena.Reset();
+    }
+
+    state.SetBytesProcessed((std::int64_t)state.iterations() * (std::int64_t)bytes.size());
+}
+
+/// @brief Display name of a client without a name, as made for every new connection.
+static void bench_format_guest_name(benchmark::State& state)
+{
+    HSteamNetConnection conn = memory_transport::FIRST_HANDLE;
+
+    for (auto _ : state)
+    {
+        std::string name = std::format("Guest#{}", conn++);
+        benchmark::DoNotOptimize(name.data());
+    }
+}
+
+/// @brief Find the client of a received message from its connection user data, in random order.
+static void bench_client_lookup(benchmark::State& state)
+{
+    const auto client_count = (std::size_t)state.range(0);
+
+    bench_registry clients;
+    std::vector<std::int64_t> user_data;
+    for (std::size_t i = 0; i < client_count; ++i)
+        user_data.push_back(bench_registry::to_user_data(clients.insert(bench_connection(i), {})));
+
+    std::mt19937 rng(12345);
+    std::shuffle(user_data.begin(), user_data.end(), rng);
+
+    std::size_t next = 0;
+    for (auto _ : state)
+    {
+        auto* client = clients.get(bench_registry::from_user_data(user_data[next]));
+        benchmark::DoNotOptimize(client);
+        if (++next == user_data.size())
+            next = 0;
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief Collect the recipients of a broadcast, like `st_chat_server::broadcast()` does.
+/// Every 10th client is removed and added again first, so the registry isn't in a freshly built state.
+static void bench_broadcast_iteration(benchmark::State& state)
+{
+    const auto client_count = (std::size_t)state.range(0);
+    const HSteamNetConnection sender = bench_connection(client_count / 2);
+
+    bench_registry clients;
+    std::vector<bench_registry::handle> handles;
+    for (std::size_t i = 0; i < client_count; ++i)
+        handles.push_back(clients.insert(bench_connection(i), {}));
+    for (std::size_t i = 0; i < client_count; i += 10)
+    {
+        clients.erase(handles[i]);
+        handles[i] = clients.insert(bench_connection(i), {});
+    }
+
+    std::vector<HSteamNetConnection> recipients;
+    recipients.reserve(client_count);
+
+    for (auto _ : state)
+    {
+        recipients.clear();
+        const auto registered_conns = clients.connections();
+        const auto hot_infos = clients.hot_infos();
+        for (std::size_t i = 0; i < registered_conns.size(); ++i)
+            if (registered_conns[i] != sender && !hot_infos[i].slow)
+                recipients.push_back(registered_conns[i]);
+        benchmark::DoNotOptimize(recipients.data());
+    }
+
+    state.SetItemsProcessed((std::int64_t)state.iterations() * (std::int64_t)client_count);
+}
+
+/// @brief Same as `bench_broadcast_iteration`, over the `std::unordered_map` that `client_registry` replaced.
+static void bench_broadcast_iteration_unordered_map(benchmark::State& state)
+{
+    const auto client_count = (std::size_t)state.range(0);
+    const HSteamNetConnection sender = bench_connection(client_count / 2);
+
+    std::unordered_map<HSteamNetConnection,
+                       std::pair<st_chat_server::client_info, st_chat_server::client_hot_info>>
+        clients;
+    for (std::size_t i = 0; i < client_count; ++i)
+        clients.try_emplace(bench_connection(i));
+    for (std::size_t i = 0; i < client_count; i += 10)
+    {
+        clients.erase(bench_connection(i));
+        clients.try_emplace(bench_connection(i));
+    }
+
+    std::vector<HSteamNetConnection> recipients;
+    recipients.reserve(client_count);
+
+    for (auto _ : state)
+    {
+        recipients.clear();
+        for (const auto& [conn, client] : clients)
+            if (conn != sender && !client.second.slow)
+                recipients.push_back(conn);
+        benchmark::DoNotOptimize(recipients.data());
+    }
+
+    state.SetItemsProcessed((std::int64_t)state.iterations() * (std::int64_t)client_count);
+}
+
+/// @brief Receive a `kChat` from a client and broadcast it to the others, through a whole server loop pass.
+/// This includes the fake transport queuing the chat and releasing the sent messages,
+/// but no sockets nor threads.
+/// `allocs/msg` counts the `allocate_message()` of every recipient, which the GNS also allocates.
+static void bench_on_message_chat(benchmark::State& state)
+{
+    const auto client_count = (std::size_t)state.range(0);
+
+    memory_transport transport;
+    st_chat_server server(transport);
+
+    st_chat_server::settings settings;
+    settings.manual_poll = true;
+    settings.chat_rate_limit = {};
+    settings.slow_consumer_check_interval = std::chrono::hours(1);
+    settings.transport_sample_interval = std::chrono::milliseconds(0);
+    if (!server.start(BENCH_PORT, settings))
+    {
+        state.SkipWithError("Failed to start the server");
+        return;
+    }
+
+    const HSteamListenSocket listen_socket = transport.find_listen_socket(BENCH_PORT);
+    std::vector<HSteamNetConnection> conns;
+    for (std::size_t i = 0; i < client_count; ++i)
+        conns.push_back(transport.connect(listen_socket));
+    server.poll();
+    if (server.get_metrics().connects.value() != client_count)
+    {
+        state.SkipWithError("Failed to connect the clients");
+        return;
+    }
+
+    const HSteamNetConnection sender = conns[client_count / 2];
+    GNSPrac::Chat::ChatProtocol msg;
+    msg.mutable_chat()->set_content(std::string(64, 'x'));
+    const std::string bytes = msg.SerializeAsString();
+
+    const auto stats_before = server.get_receive_stats();
+    const auto sent_before = transport.get_stats();
+
+    for (auto _ : state)
+    {
+        transport.send_to_server(sender, bytes.data(), (int)bytes.size());
+        server.poll();
+    }
+
+    const auto stats = server.get_receive_stats();
+    const auto sent = transport.get_stats();
+    const auto chats = (double)(stats.total_drained - stats_before.total_drained);
+    state.SetItemsProcessed(state.iterations());
+    state.counters["allocs/msg"] = (double)(stats.message_allocations - stats_before.message_allocations) / chats;
+    state.counters["sent/msg"] = (double)(sent.messages_sent - sent_before.messages_sent) / chats;
+
+    server.stop();
+}
+
+/// @brief Receive a `kJoinRoom` and a `kLeaveRoom` in turns, which are parsed as a whole unlike the chats,
+/// from a protobuf arena or from the heap.
+static void bench_on_message_join_leave(benchmark::State& state)
+{
+    memory_transport transport;
+    st_chat_server server(transport);
+
+    st_chat_server::settings settings;
+    settings.manual_poll = true;
+    settings.use_protobuf_arena = state.range(0) != 0;
+    settings.room_rate_limit = {};
+    settings.slow_consumer_check_interval = std::chrono::hours(1);
+    settings.transport_sample_interval = std::chrono::milliseconds(0);
+    if (!server.start(BENCH_PORT, settings))
+    {
+        state.SkipWithError("Failed to start the server");
+        return;
+    }
+
+    const HSteamNetConnection conn = transport.connect(transport.find_listen_socket(BENCH_PORT));
+    server.poll();
+
+    GNSPrac::Chat::ChatProtocol msg;
+    msg.mutable_join_room()->set_room("bench");
+    const std::string join_bytes = msg.SerializeAsString();
+    msg.mutable_leave_room()->set_room("bench");
+    const std::string leave_bytes = msg.SerializeAsString();
+
+    const auto stats_before = server.get_receive_stats();
+
+    for (auto _ : state)
+    {
+        transport.send_to_server(conn, join_bytes.data(), (int)join_bytes.size());
+        transport.send_to_server(conn, leave_bytes.data(), (int)leave_bytes.size());
+        server.poll();
+    }
+
+    const auto stats = server.get_receive_stats();
+    const auto messages = (double)(stats.total_drained - stats_before.total_drained);
+    state.SetItemsProcessed((std::int64_t)messages);
+    state.counters["allocs/msg"] = (double)(stats.message_allocations - stats_before.message_allocations) / messages;
+
+    server.stop();
+}
+
+/// @brief How the server loop of `bench_relay_latency` waits between its passes.
+enum class relay_loop : std::int64_t
+{
+    /// @brief Sleep 10 ms after every pass, as the server loop used to.
+    sleep_10ms = 0,
+    /// @brief The server's own loop, which waits on the transport until something arrives.
+    event_driven = 1,
+};
+
+/// @brief Time from a client sending a `kChat` to the server relaying it to the other client,
+/// with the server loop on its own thread.
+/// The chats are sent at random times, so they arrive at random points of the server loop.
+/// This runs over `memory_transport`, whose wait is a condition variable rather than the GNS poll,
+/// so it measures the server loop, not the wake-up latency of the GNS sockets over loopback.
+static void bench_relay_latency(benchmark::State& state)
+{
+    const auto loop = (relay_loop)state.range(0);
+
+    memory_transport transport;
+    st_chat_server server(transport);
+
+    // The time the last relay was sent, as the count of relays changes
+    std::atomic<std::int64_t> relay_count{0};
+    std::atomic<std::int64_t> relay_time_ns{0};
+    transport.set_sent_message_sink([&](const SteamNetworkingMessage_t&) {
+        relay_time_ns.store(std::chrono::steady_clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+        relay_count.fetch_add(1, std::memory_order_release);
+        relay_count.notify_one();
+    });
+
+    st_chat_server::settings settings;
+    settings.manual_poll = loop == relay_loop::sleep_10ms;
+    settings.chat_rate_limit = {};
+    settings.slow_consumer_check_interval = std::chrono::hours(1);
+    settings.transport_sample_interval = std::chrono::milliseconds(0);
+    if (!server.start(BENCH_PORT, settings))
+    {
+        state.SkipWithError("Failed to start the server");
+        return;
+    }
+
+    std::atomic<bool> quit{false};
+    std::thread sleeping_loop;
+    if (loop == relay_loop::sleep_10ms)
+    {
+        sleeping_loop = std::thread([&] {
+            while (!quit.load(std::memory_order_relaxed))
+            {
+                server.poll();
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        });
+    }
+
+    const HSteamListenSocket listen_socket = transport.find_listen_socket(BENCH_PORT);
+    const HSteamNetConnection sender = transport.connect(listen_socket);
+    transport.connect(listen_socket);
+    while (server.get_metrics().connects.value() != 2)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    GNSPrac::Chat::ChatProtocol msg;
+    msg.mutable_chat()->set_content(std::string(64, 'x'));
+    const std::string bytes = msg.SerializeAsString();
+
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<int> gap_us(0, 10'000);
+    std::vector<double> latencies_us;
+    latencies_us.reserve((std::size_t)state.max_iterations);
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::this_thread::sleep_for(std::chrono::microseconds(gap_us(rng)));
+        const std::int64_t count_before = relay_count.load(std::memory_order_acquire);
+        state.ResumeTiming();
+
+        const auto send_time = std::chrono::steady_clock::now();
+        transport.send_to_server(sender, bytes.data(), (int)bytes.size());
+        relay_count.wait(count_before, std::memory_order_acquire);
+
+        const auto relay_time = std::chrono::steady_clock::time_point(
+            std::chrono::steady_clock::duration(relay_time_ns.load(std::memory_order_relaxed)));
+        latencies_us.push_back(std::chrono::duration<double, std::micro>(relay_time - send_time).count());
+    }
+
+    quit.store(true, std::memory_order_relaxed);
+    if (sleeping_loop.joinable())
+        sleeping_loop.join();
+    server.stop();
+
+    std::sort(latencies_us.begin(), latencies_us.end());
+    const auto percentile = [&](double p) {
+        return latencies_us[std::min(latencies_us.size() - 1, (std::size_t)(p * (double)latencies_us.size()))];
+    };
+    state.counters["p50_us"] = percentile(0.50);
+    state.counters["p99_us"] = percentile(0.99);
+}
+
+BENCHMARK(bench_serialize_chat)->RangeMultiplier(16)->Range(16, 64 << 10);
+BENCHMARK(bench_parse_chat)->RangeMultiplier(16)->Range(16, 64 << 10);
+BENCHMARK(bench_parse_chat_arena)->RangeMultiplier(16)->Range(16, 64 << 10);
+BENCHMARK(bench_format_guest_name);
+BENCHMARK(bench_client_lookup)->Arg(100)->Arg(1'000)->Arg(10'000)->Arg(50'000)->Arg(100'000);
+BENCHMARK(bench_broadcast_iteration)->Arg(100)->Arg(1'000)->Arg(10'000)->Arg(50'000)->Arg(100'000);
+BENCHMARK(bench_broadcast_iteration_unordered_map)->Arg(100)->Arg(1'000)->Arg(10'000)->Arg(50'000)->Arg(100'000);
+BENCHMARK(bench_on_message_chat)->RangeMultiplier(10)->Range(1, 10'000)->Unit(benchmark::kMicrosecond);
+BENCHMARK(bench_on_message_join_leave)->ArgName("arena")->Arg(0)->Arg(1);
+BENCHMARK(bench_relay_latency)
+    ->ArgName("event_driven")
+    ->Arg((std::int64_t)relay_loop::sleep_10ms)
+    ->Arg((std::int64_t)relay_loop::event_driven)
+    ->Iterations(1000)
+    ->UseRealTime()
+    ->Unit(benchmark::kMicrosecond);
+
+int main(int argc, char** argv)
+{
+    // Write the JSON results by default; the flags given later override these.
+    static char out_arg[] = "--benchmark_out=chat_bench.json";
+    static char out_format_arg[] = "--benchmark_out_format=json";
+
+    std::vector<char*> args{argv[0], out_arg, out_format_arg};
+    args.insert(args.end(), argv + 1, argv + argc);
+    int arg_count = (int)args.size();
+
+    benchmark::Initialize(&arg_count, args.data());
+    if (benchmark::ReportUnrecognizedArguments(arg_count, args.data()))
+        return 1;
+
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
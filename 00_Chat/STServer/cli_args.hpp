@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+// Parsing of the command line arguments, shared by the servers, the client and the load generators.
+
+/// @brief Parse the whole `str` as an integer.
+/// @return Whether `str` was a valid integer.
+inline bool parse_long(std::string_view str, long& out)
+{
+    const std::string null_terminated(str);
+    char* end;
+    out = std::strtol(null_terminated.c_str(), &end, 0);
+    return !null_terminated.empty() && *end == '\0';
+}
+
+/// @brief Parse the whole `str` as a floating point number.
+/// @return Whether `str` was a valid number.
+inline bool parse_double(std::string_view str, double& out)
+{
+    const std::string null_terminated(str);
+    char* end;
+    out = std::strtod(null_terminated.c_str(), &end);
+    return !null_terminated.empty() && *end == '\0';
+}
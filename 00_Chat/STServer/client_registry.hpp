@@ -0,0 +1,212 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+/// @brief Contiguous registry of the clients, which is a slot map with generation counters.
+///
+/// The clients and their connections are stored in packed arrays, so a broadcast iterates them linearly
+/// instead of chasing the nodes of a `std::unordered_map`.
+/// The few fields of a client read by every broadcast, `HotInfo`, are packed in an array of their own,
+/// so a broadcast doesn't pull the rest of the `ClientInfo` of every client into the cache.
+/// Removing a client moves the last one into its place, so the order of the clients is not kept.
+///
+/// A `handle` stays valid until its client is removed; a stale handle doesn't find the client that took its slot,
+/// as the generation of the slot is bumped on every removal.
+///
+/// The handle of a client is meant to be stored in the connection's user data
+/// (see `ISteamNetworkingSockets::SetConnectionUserData()`), so the callbacks and the received messages
+/// reach the client without any hash lookup.
+template <typename ClientInfo, typename HotInfo>
+class client_registry
+{
+public:
+    struct handle
+    {
+        std::uint32_t index = INVALID_INDEX;
+        std::uint32_t generation = 0;
+
+        bool operator==(const handle&) const = default;
+    };
+
+    static constexpr std::uint32_t INVALID_INDEX = UINT32_MAX;
+
+private:
+    struct slot
+    {
+        // Index into the packed arrays, or the next free slot if this slot is free.
+        std::uint32_t dense_index;
+        std::uint32_t generation = 0;
+    };
+
+private:
+    // Packed arrays, all in the same order
+    std::vector<HSteamNetConnection> _conns;
+    std::vector<ClientInfo> _clients;
+    std::vector<HotInfo> _hot_infos;
+    std::vector<std::uint32_t> _dense_to_slot;
+
+    std::vector<slot> _slots;
+    std::uint32_t _free_head = INVALID_INDEX;
+
+public:
+    auto size() const -> std::size_t
+    {
+        return _conns.size();
+    }
+
+    bool empty() const
+    {
+        return _conns.empty();
+    }
+
+    /// @brief Connections of all the clients, packed for linear iteration.
+    /// `connections()[i]` is the connection of `clients()[i]`, and `hot_infos()[i]` is its `HotInfo`.
+    auto connections() const -> std::span<const HSteamNetConnection>
+    {
+        return _conns;
+    }
+
+    auto clients() -> std::span<ClientInfo>
+    {
+        return _clients;
+    }
+
+    auto clients() const -> std::span<const ClientInfo>
+    {
+        return _clients;
+    }
+
+    auto hot_infos() -> std::span<HotInfo>
+    {
+        return _hot_infos;
+    }
+
+    auto hot_infos() const -> std::span<const HotInfo>
+    {
+        return _hot_infos;
+    }
+
+    /// @brief Pack the handle into the connection user data.
+    static auto to_user_data(handle h) -> std::int64_t
+    {
+        return (std::int64_t)(((std::uint64_t)h.generation << 32) | h.index);
+    }
+
+    /// @brief Unpack the handle from the connection user data.
+    /// The default user data of GNS, -1, is unpacked to an invalid handle.
+    static auto from_user_data(std::int64_t user_data) -> handle
+    {
+        return handle{.index = (std::uint32_t)user_data, .generation = (std::uint32_t)((std::uint64_t)user_data >> 32)};
+    }
+
+    /// @brief Add a client of the connection.
+    /// @return Handle of the client.
+    auto insert(HSteamNetConnection conn, ClientInfo client, HotInfo hot_info = {}) -> handle
+    {
+        std::uint32_t slot_index;
+        if (_free_head != INVALID_INDEX)
+        {
+            slot_index = _free_head;
+            _free_head = _slots[slot_index].dense_index;
+        }
+        else
+        {
+            slot_index = (std::uint32_t)_slots.size();
+            _slots.push_back(slot{});
+        }
+
+        slot& s = _slots[slot_index];
+        s.dense_index = (std::uint32_t)_conns.size();
+
+        _conns.push_back(conn);
+        _clients.push_back(std::move(client));
+        _hot_infos.push_back(std::move(hot_info));
+        _dense_to_slot.push_back(slot_index);
+
+        return handle{.index = slot_index, .generation = s.generation};
+    }
+
+    /// @brief Remove the client of the handle.
+    /// This invalidates the handle, and the pointers to the last client.
+    /// @return Whether there was a client to remove.
+    bool erase(handle h)
+    {
+        if (!contains(h))
+            return false;
+
+        const std::uint32_t slot_index = h.index;
+        slot& s = _slots[slot_index];
+        const std::uint32_t dense_index = s.dense_index;
+        const std::uint32_t last_index = (std::uint32_t)_conns.size() - 1;
+
+        // Move the last client into the hole
+        if (dense_index != last_index)
+        {
+            _conns[dense_index] = _conns[last_index];
+            _clients[dense_index] = std::move(_clients[last_index]);
+            _hot_infos[dense_index] = std::move(_hot_infos[last_index]);
+            _dense_to_slot[dense_index] = _dense_to_slot[last_index];
+            _slots[_dense_to_slot[dense_index]].dense_index = dense_index;
+        }
+        _conns.pop_back();
+        _clients.pop_back();
+        _hot_infos.pop_back();
+        _dense_to_slot.pop_back();
+
+        // Invalidate the handles to this slot, and put it on the free list
+        ++s.generation;
+        s.dense_index = _free_head;
+        _free_head = slot_index;
+
+        return true;
+    }
+
+    void clear()
+    {
+        _conns.clear();
+        _clients.clear();
+        _hot_infos.clear();
+        _dense_to_slot.clear();
+        _slots.clear();
+        _free_head = INVALID_INDEX;
+    }
+
+    /// @brief Whether the handle refers to a client, i.e. it's not invalid nor stale.
+    bool contains(handle h) const
+    {
+        return h.index < _slots.size() && _slots[h.index].generation == h.generation;
+    }
+
+    /// @return The client of the handle, or `nullptr` if it has been removed.
+    auto get(handle h) -> ClientInfo*
+    {
+        return contains(h) ? &_clients[_slots[h.index].dense_index] : nullptr;
+    }
+
+    /// @return The `HotInfo` of the handle, or `nullptr` if it has been removed.
+    auto get_hot_info(handle h) -> HotInfo*
+    {
+        return contains(h) ? &_hot_infos[_slots[h.index].dense_index] : nullptr;
+    }
+
+    /// @return The connection of the handle, or `k_HSteamNetConnection_Invalid` if it has been removed.
+    auto connection_of(handle h) const -> HSteamNetConnection
+    {
+        return contains(h) ? _conns[_slots[h.index].dense_index] : k_HSteamNetConnection_Invalid;
+    }
+
+    /// @return The handle of `clients()[dense_index]`.
+    auto handle_at(std::size_t dense_index) const -> handle
+    {
+        const std::uint32_t slot_index = _dense_to_slot[dense_index];
+        return handle{.index = slot_index, .generation = _slots[slot_index].generation};
+    }
+};
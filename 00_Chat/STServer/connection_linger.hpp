@@ -0,0 +1,84 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "logger.hpp"
+#include "transport.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/// @brief Shutdown of the connections of a stopping server, shared by the servers on a `transport`.
+namespace connection_linger
+{
+
+/// @brief Upper bound of a single wait on the sockets, between the checks of the send queues.
+/// The acks arriving wake it up sooner, so this only matters for the connections waiting on a retransmission.
+inline constexpr int POLL_WAIT_MILLISECONDS = 10;
+
+/// @brief Whether the connection still has something to send, or to be acknowledged by the client.
+/// A connection closed by the client, or lost, has nothing more to send.
+inline bool has_unsent_data(transport& sockets, HSteamNetConnection conn)
+{
+    SteamNetConnectionRealTimeStatus_t status{};
+    if (sockets.get_connection_real_time_status(conn, status) != k_EResultOK)
+        return false;
+    if (status.m_eState != k_ESteamNetworkingConnectionState_Connected)
+        return false;
+
+    return status.m_cbPendingReliable > 0 || status.m_cbSentUnackedReliable > 0 || status.m_cbPendingUnreliable > 0;
+}
+
+/// @brief Close each connection once it's sent everything queued to it, waiting up to `linger_milliseconds`.
+/// The rest are closed with the linger of the GNS, which gives up on them when the listen socket is closed.
+///
+/// The connections are kept open until then, as a closed connection's handle can't be asked for its send queue.
+/// As we're on the manual poll mode, nobody services the sockets unless someone polls them,
+/// so this polls them while waiting, instead of just sleeping, which might never flush them.
+/// Call this after the server has stopped polling by itself, so nothing more is queued to the connections.
+/// @param seen_wake_seq Wake sequence seen by the caller, see `transport::wait()`.
+/// @return Number of connections that still had something to send when the wait was given up.
+inline auto close_when_flushed(transport& sockets, std::uint64_t& seen_wake_seq, std::vector<HSteamNetConnection> conns,
+                               int linger_milliseconds) -> std::size_t
+{
+    const auto linger_start = std::chrono::steady_clock::now();
+    const auto linger_end = linger_start + std::chrono::milliseconds(linger_milliseconds);
+
+    const std::size_t conn_count = conns.size();
+    while (true)
+    {
+        std::erase_if(conns, [&sockets](HSteamNetConnection conn) {
+            if (has_unsent_data(sockets, conn))
+                return false;
+            sockets.close_connection(conn, 0, "Server shutdown", false);
+            return true;
+        });
+
+        const auto now = std::chrono::steady_clock::now();
+        if (conns.empty() || now >= linger_end)
+            break;
+
+        const auto remaining = std::chrono::ceil<std::chrono::milliseconds>(linger_end - now).count();
+        sockets.wait(seen_wake_seq, (int)std::min<long long>(remaining, POLL_WAIT_MILLISECONDS));
+    }
+
+    for (const auto conn : conns)
+        sockets.close_connection(conn, 0, "Server shutdown", true);
+
+    const auto lingered_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - linger_start);
+    if (conns.empty())
+        logger::info("Flushed {} connections in {}ms", conn_count, lingered_ms.count());
+    else
+        logger::warning("Gave up flushing after {}ms: {} of {} connections still had data to send",
+                        lingered_ms.count(), conns.size(), conn_count);
+
+    return conns.size();
+}
+
+} // namespace connection_linger
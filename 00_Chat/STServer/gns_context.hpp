@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "logger.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+
+/// @brief Process-wide `GameNetworkingSockets` state, shared by all the servers in this process.
+///
+/// GNS is initialized only once, by the first server that starts, and killed by the last one that stops.
+/// As GNS is on the manual poll mode, only one thread polls the sockets at a time (the "leader"),
+/// and it runs the callbacks and wakes up all the other threads waiting on `wait()` (the "followers").
+/// This way, a packet for any server wakes up the server thread that owns it right away.
+class gns_context
+{
+private:
+    static inline std::mutex _init_mutex;
+    static inline int _users = 0;
+
+    static inline std::mutex _poll_mutex;
+
+    static inline std::mutex _wake_mutex;
+    static inline std::condition_variable _wake_cv;
+    static inline std::uint64_t _wake_seq = 0;
+
+public:
+    /// @brief Initialize GNS if this is the first user.
+    /// Throws `std::runtime_error` if the initialization failed.
+    static void acquire()
+    {
+        std::lock_guard lock(_init_mutex);
+
+        if (_users == 0)
+        {
+            // Service the sockets from our own threads, instead of the GNS's internal service thread.
+            // This lets the server loops block until something actually arrives, rather than sleeping blindly.
+            // Note that this must be set before initializing `GameNetworkingSockets`.
+            SteamNetworkingSockets_SetManualPollMode(true);
+
+            // Initialize `GameNetworkingSockets`
+            SteamDatagramErrMsg err_msg;
+            if (!GameNetworkingSockets_Init(nullptr, err_msg))
+                throw std::runtime_error(err_msg);
+
+            // Route the debug output of GNS to our logger, instead of letting it write to the console by itself
+            SteamNetworkingUtils()->SetDebugOutputFunction(k_ESteamNetworkingSocketsDebugOutputType_Msg,
+                                                           logger::on_gns_debug_output);
+        }
+
+        ++_users;
+    }
+
+    /// @brief Kill GNS if this was the last user.
+    static void release()
+    {
+        std::lock_guard lock(_init_mutex);
+
+        if (--_users == 0)
+            GameNetworkingSockets_Kill();
+    }
+
+    /// @brief Prevent other threads from polling the sockets and running the callbacks, while the lock is held.
+    /// This is useful to register something the callbacks look up, before any callback can see it.
+    [[nodiscard]] static auto lock_polling() -> std::unique_lock<std::mutex>
+    {
+        return std::unique_lock(_poll_mutex);
+    }
+
+    /// @brief Wait until the sockets had some activity, or `max_wait_milliseconds` has passed.
+    /// If no one else is polling the sockets, this thread polls them and runs the callbacks.
+    /// @param seen_wake_seq Wake sequence seen by the caller, updated on return.
+    /// If there was activity since the caller last saw, this returns right away.
+    /// @param max_wait_milliseconds Upper bound of the wait.
+    static void wait(std::uint64_t& seen_wake_seq, int max_wait_milliseconds)
+    {
+        if (std::unique_lock poll_lock(_poll_mutex, std::try_to_lock); poll_lock)
+        {
+            {
+                std::lock_guard wake_lock(_wake_mutex);
+                if (_wake_seq != seen_wake_seq)
+                {
+                    // Someone polled after we last saw, so handle that first.
+                    max_wait_milliseconds = 0;
+                }
+            }
+
+            // Block until the sockets have something for us, or a GNS timer is due.
+            SteamNetworkingSockets_Poll(max_wait_milliseconds);
+
+            // Callbacks are run only here, so that they're dispatched before waking up the followers.
+            SteamNetworkingSockets()->RunCallbacks();
+
+            poll_lock.unlock();
+
+            wake_all(seen_wake_seq);
+        }
+        else
+        {
+            std::unique_lock wake_lock(_wake_mutex);
+            _wake_cv.wait_for(wake_lock, std::chrono::milliseconds(max_wait_milliseconds),
+                              [&seen_wake_seq] { return _wake_seq != seen_wake_seq; });
+            seen_wake_seq = _wake_seq;
+        }
+    }
+
+    /// @brief Wake up all the threads waiting on `wait()`.
+    static void wake_all()
+    {
+        std::uint64_t seen_wake_seq;
+        wake_all(seen_wake_seq);
+    }
+
+private:
+    static void wake_all(std::uint64_t& seen_wake_seq)
+    {
+        {
+            std::lock_guard wake_lock(_wake_mutex);
+            seen_wake_seq = ++_wake_seq;
+        }
+        _wake_cv.notify_all();
+    }
+};
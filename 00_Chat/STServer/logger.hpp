@@ -0,0 +1,365 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+/// @brief Lowest level compiled in; the calls below this level are removed at compile time.
+/// 0: debug, 1: info, 2: warning, 3: error
+#ifndef CHAT_LOG_MIN_LEVEL
+#ifdef NDEBUG
+#define CHAT_LOG_MIN_LEVEL 1
+#else
+#define CHAT_LOG_MIN_LEVEL 0
+#endif
+#endif
+
+enum class log_level : std::uint8_t
+{
+    debug,
+    info,
+    warning,
+    error,
+};
+
+/// @brief Format string of a log call, checked against the arguments at compile time as `std::format_string` is.
+/// It keeps the string itself, which `std::format_string` gives out only from C++23 on.
+template <typename... Args>
+struct log_format_string
+{
+    std::string_view str;
+
+    template <typename T>
+        requires std::convertible_to<const T&, std::string_view>
+    consteval log_format_string(const T& format) : str(format)
+    {
+        [[maybe_unused]] const std::format_string<Args...> checked(format);
+    }
+};
+
+/// @brief Asynchronous logger, which keeps the console writes off the server loops.
+///
+/// A log call copies its format arguments into a fixed-size record of a lock-free ring buffer,
+/// and a background thread formats and writes the records.
+/// Logging never blocks nor allocates on the calling thread: if the ring buffer is full, the record is dropped
+/// and counted instead.
+///
+/// Arguments can be arithmetic types, or anything convertible to `std::string_view`.
+/// Strings are copied into the record, and truncated if they don't fit in it.
+class logger
+{
+public:
+    static constexpr log_level MIN_LEVEL = (log_level)CHAT_LOG_MIN_LEVEL;
+
+    /// @brief Number of records in the ring buffer; must be a power of two.
+    static constexpr std::size_t CAPACITY = 8192;
+    /// @brief Bytes in a record for the format arguments.
+    static constexpr std::size_t ARGS_SIZE = 224;
+
+    struct stats
+    {
+        std::uint64_t written;
+        /// @brief Records dropped, as the ring buffer was full.
+        std::uint64_t dropped;
+    };
+
+private:
+    struct record
+    {
+        log_level level;
+        std::string_view format;
+        // Decodes the arguments and formats them; instantiated with the same argument types the record was made with.
+        void (*format_fn)(const record&, std::string& out);
+        std::byte args[ARGS_SIZE];
+    };
+
+    struct cell
+    {
+        // Vyukov's bounded queue: a cell is ready to write when this is its position,
+        // and ready to read when it's its position + 1.
+        std::atomic<std::size_t> sequence;
+        record rec;
+    };
+
+    template <typename T>
+    static constexpr bool is_string_arg = std::is_convertible_v<const T&, std::string_view>;
+
+    // Type an argument is stored as, in a record
+    template <typename T>
+    using stored_t = std::conditional_t<is_string_arg<std::decay_t<T>>, std::string_view, std::decay_t<T>>;
+
+    // Strings are stored as their length followed by their bytes
+    using string_length_t = std::uint16_t;
+
+private:
+    std::unique_ptr<cell[]> _cells;
+    alignas(64) std::atomic<std::size_t> _enqueue_pos{0};
+    alignas(64) std::size_t _dequeue_pos = 0;
+
+    alignas(64) std::atomic<std::uint64_t> _written{0};
+    std::atomic<std::uint64_t> _dropped{0};
+
+    std::atomic<bool> _quit_requested{false};
+    std::thread _writer_thread;
+
+    // Whether the writer thread is waiting for a record, to be woken up by the next one.
+    // The log calls only touch this with a load, unless the writer thread is actually waiting.
+    alignas(64) std::atomic<bool> _writer_parked{false};
+
+private:
+    logger() : _cells(std::make_unique<cell[]>(CAPACITY))
+    {
+        static_assert(std::has_single_bit(CAPACITY));
+
+        for (std::size_t i = 0; i < CAPACITY; ++i)
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+
+        _writer_thread = std::thread(&logger::writer_loop, this);
+    }
+
+public:
+    logger(const logger&) = delete;
+    logger& operator=(const logger&) = delete;
+
+    /// @brief Write all the records left, and stop the background thread.
+    ~logger()
+    {
+        _quit_requested.store(true, std::memory_order_seq_cst);
+        wake_writer();
+        _writer_thread.join();
+    }
+
+    /// @brief Logger shared by everything in this process.
+    static auto shared() -> logger&
+    {
+        static logger instance;
+        return instance;
+    }
+
+    template <typename... Args>
+    static void debug(log_format_string<std::type_identity_t<Args>...> format, Args&&... args)
+    {
+        if constexpr (log_level::debug >= MIN_LEVEL)
+            shared().write<Args...>(log_level::debug, format.str, args...);
+    }
+
+    template <typename... Args>
+    static void info(log_format_string<std::type_identity_t<Args>...> format, Args&&... args)
+    {
+        if constexpr (log_level::info >= MIN_LEVEL)
+            shared().write<Args...>(log_level::info, format.str, args...);
+    }
+
+    template <typename... Args>
+    static void warning(log_format_string<std::type_identity_t<Args>...> format, Args&&... args)
+    {
+        if constexpr (log_level::warning >= MIN_LEVEL)
+            shared().write<Args...>(log_level::warning, format.str, args...);
+    }
+
+    template <typename... Args>
+    static void error(log_format_string<std::type_identity_t<Args>...> format, Args&&... args)
+    {
+        if constexpr (log_level::error >= MIN_LEVEL)
+            shared().write<Args...>(log_level::error, format.str, args...);
+    }
+
+    /// @brief Debug output of the GNS, routed to this logger.
+    /// Set with `ISteamNetworkingUtils::SetDebugOutputFunction()`.
+    static void on_gns_debug_output(ESteamNetworkingSocketsDebugOutputType type, const char* msg)
+    {
+        if (type <= k_ESteamNetworkingSocketsDebugOutputType_Error)
+            error("[GNS] {}", msg);
+        else if (type <= k_ESteamNetworkingSocketsDebugOutputType_Warning)
+            warning("[GNS] {}", msg);
+        else if (type <= k_ESteamNetworkingSocketsDebugOutputType_Msg)
+            info("[GNS] {}", msg);
+        else
+            debug("[GNS] {}", msg);
+    }
+
+    auto get_stats() const -> stats
+    {
+        return stats{
+            .written = _written.load(std::memory_order_relaxed),
+            .dropped = _dropped.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    template <typename... Args>
+    void write(log_level level, std::string_view format, const std::remove_reference_t<Args>&... args)
+    {
+        constexpr std::size_t fixed_size = ((is_string_arg<std::decay_t<Args>> ? sizeof(string_length_t)
+                                                                                : sizeof(stored_t<Args>)) +
+                                            ... + 0);
+        static_assert(fixed_size <= ARGS_SIZE, "Too many arguments to fit in a log record");
+        static_assert(((is_string_arg<std::decay_t<Args>> || std::is_trivially_copyable_v<stored_t<Args>>) && ...),
+                      "Log arguments must be arithmetic types or strings");
+
+        // Claim a cell
+        std::size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+        cell* c;
+        while (true)
+        {
+            c = &_cells[pos & (CAPACITY - 1)];
+            const std::size_t sequence = c->sequence.load(std::memory_order_acquire);
+            const auto diff = (std::intptr_t)sequence - (std::intptr_t)pos;
+            if (diff == 0)
+            {
+                if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                // The writer thread is a whole ring behind
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            else
+                pos = _enqueue_pos.load(std::memory_order_relaxed);
+        }
+
+        // Fill the record
+        record& rec = c->rec;
+        rec.level = level;
+        rec.format = format;
+        rec.format_fn = &format_record<stored_t<Args>...>;
+
+        [[maybe_unused]] std::byte* out = rec.args;
+        [[maybe_unused]] std::size_t string_space = ARGS_SIZE - fixed_size;
+        (encode_arg(out, string_space, args), ...);
+
+        // Hand it to the writer thread, waking it up if it's waiting.
+        // Both this and the writer thread's check before waiting are sequentially consistent,
+        // so either it sees this record, or this sees it waiting.
+        c->sequence.store(pos + 1, std::memory_order_seq_cst);
+        wake_writer();
+    }
+
+    void wake_writer()
+    {
+        if (_writer_parked.load(std::memory_order_seq_cst) && _writer_parked.exchange(false))
+            _writer_parked.notify_one();
+    }
+
+    template <typename T>
+    static void encode_arg(std::byte*& out, std::size_t& string_space, const T& arg)
+    {
+        if constexpr (is_string_arg<T>)
+        {
+            const std::string_view str = arg;
+            const auto length = (string_length_t)std::min({str.size(), string_space, (std::size_t)UINT16_MAX});
+            string_space -= length;
+
+            std::memcpy(out, &length, sizeof(length));
+            std::memcpy(out + sizeof(length), str.data(), length);
+            out += sizeof(length) + length;
+        }
+        else
+        {
+            std::memcpy(out, &arg, sizeof(T));
+            out += sizeof(T);
+        }
+    }
+
+    template <typename T>
+    static auto decode_arg(const std::byte*& in) -> T
+    {
+        if constexpr (std::is_same_v<T, std::string_view>)
+        {
+            string_length_t length;
+            std::memcpy(&length, in, sizeof(length));
+            const std::string_view str(reinterpret_cast<const char*>(in + sizeof(length)), length);
+            in += sizeof(length) + length;
+            return str;
+        }
+        else
+        {
+            T value;
+            std::memcpy(&value, in, sizeof(T));
+            in += sizeof(T);
+            return value;
+        }
+    }
+
+    template <typename... Stored>
+    static void format_record(const record& rec, std::string& out)
+    {
+        [[maybe_unused]] const std::byte* in = rec.args;
+        // Braced initialization, so that the arguments are decoded in order
+        std::tuple<Stored...> values{decode_arg<Stored>(in)...};
+
+        std::apply([&](auto&... value) { std::vformat_to(std::back_inserter(out), rec.format,
+                                                         std::make_format_args(value...)); },
+                   values);
+    }
+
+    /// @brief Format and write the records on the background thread.
+    void writer_loop()
+    {
+        std::string line;
+
+        while (true)
+        {
+            cell& c = _cells[_dequeue_pos & (CAPACITY - 1)];
+            if (c.sequence.load(std::memory_order_acquire) != _dequeue_pos + 1)
+            {
+                // Nothing to write, so flush what's written so far, and wait for the next record
+                std::fflush(stdout);
+                if (_quit_requested.load(std::memory_order_relaxed))
+                    break;
+
+                // Check again after announcing the wait, so a record written in between isn't missed
+                _writer_parked.store(true, std::memory_order_seq_cst);
+                if (c.sequence.load(std::memory_order_seq_cst) != _dequeue_pos + 1 &&
+                    !_quit_requested.load(std::memory_order_seq_cst))
+                    _writer_parked.wait(true);
+                _writer_parked.store(false, std::memory_order_relaxed);
+                continue;
+            }
+
+            line.clear();
+            switch (c.rec.level)
+            {
+            case log_level::debug:
+                line += "[debug] ";
+                break;
+            case log_level::warning:
+                line += "[warning] ";
+                break;
+            case log_level::error:
+                line += "[error] ";
+                break;
+            default:
+                break;
+            }
+            c.rec.format_fn(c.rec, line);
+            line += '\n';
+
+            // Release the cell for the next ring
+            c.sequence.store(_dequeue_pos + CAPACITY, std::memory_order_release);
+            ++_dequeue_pos;
+
+            std::fwrite(line.data(), 1, line.size(), stdout);
+            _written.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
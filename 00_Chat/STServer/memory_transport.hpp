@@ -0,0 +1,490 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "transport.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/// @brief In-memory fake of the transport, for the deterministic benchmarks of the server logic.
+///
+/// There are no sockets nor GNS behind it: the benchmark plays the clients with `connect()`, `send_to_server()`
+/// and `disconnect()`, which queue the connection status changes and the messages right into the poll groups,
+/// and the messages the server sends are counted, handed to the sink if any, and released right away.
+///
+/// A `CreateSocketPair()` loopback pair wasn't used, as its connections aren't accepted from a listen socket,
+/// so the server's accept path would be skipped, and it still goes through the GNS's global lock.
+///
+/// Handles start from `FIRST_HANDLE`, so they don't collide with the GNS's ones in the server's lookups.
+class memory_transport final : public transport
+{
+public:
+    static constexpr std::uint32_t FIRST_HANDLE = 0x4000'0000;
+
+    /// @brief Messages the server has sent.
+    struct stats
+    {
+        std::uint64_t messages_sent;
+        std::uint64_t bytes_sent;
+    };
+
+    /// @brief Called with every message the server sends, before it's released.
+    using sent_message_sink = std::function<void(const SteamNetworkingMessage_t&)>;
+
+private:
+    // Messages made by this, freed by `Release()` like the GNS's ones
+    struct fake_message : SteamNetworkingMessage_t
+    {
+        fake_message() : SteamNetworkingMessage_t()
+        {
+            m_pfnRelease = release;
+        }
+
+        static void release(SteamNetworkingMessage_t* msg)
+        {
+            if (msg->m_pfnFreeData)
+                msg->m_pfnFreeData(msg);
+            delete static_cast<fake_message*>(msg);
+        }
+
+        static void free_buffer(SteamNetworkingMessage_t* msg)
+        {
+            delete[] static_cast<std::byte*>(msg->m_pData);
+        }
+    };
+
+    struct connection
+    {
+        HSteamListenSocket listen_socket;
+        ESteamNetworkingConnectionState state = k_ESteamNetworkingConnectionState_Connecting;
+        std::int64_t user_data = -1;
+        HSteamNetPollGroup poll_group = k_HSteamNetPollGroup_Invalid;
+        stats sent{};
+    };
+
+    using status_changed_callback = FnSteamNetConnectionStatusChanged;
+
+    struct listen_socket_info
+    {
+        std::uint16_t port;
+        status_changed_callback callback;
+    };
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _wake_cv;
+    std::uint64_t _wake_seq = 0;
+
+    std::uint32_t _next_handle = FIRST_HANDLE;
+    std::unordered_map<HSteamListenSocket, listen_socket_info> _listen_sockets;
+    std::unordered_map<HSteamNetPollGroup, std::deque<SteamNetworkingMessage_t*>> _poll_groups;
+    std::unordered_map<HSteamNetConnection, connection> _conns;
+    std::vector<SteamNetConnectionStatusChangedCallback_t> _pending_callbacks;
+
+    stats _stats{};
+    sent_message_sink _sink;
+
+    // Held while running the callbacks
+    std::mutex _poll_mutex;
+
+public:
+    memory_transport() = default;
+
+    memory_transport(const memory_transport&) = delete;
+    memory_transport& operator=(const memory_transport&) = delete;
+
+    ~memory_transport() override
+    {
+        for (auto& [poll_group, msgs] : _poll_groups)
+            for (auto* msg : msgs)
+                msg->Release();
+    }
+
+public:
+    /// @brief Set the sink to see the messages the server sends, e.g. to check them.
+    /// Set it before the server starts.
+    void set_sent_message_sink(sent_message_sink sink)
+    {
+        std::lock_guard lock(_mutex);
+        _sink = std::move(sink);
+    }
+
+    auto get_stats() -> stats
+    {
+        std::lock_guard lock(_mutex);
+        return _stats;
+    }
+
+    /// @return Messages the server has sent to the connection.
+    auto get_connection_stats(HSteamNetConnection conn) -> stats
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        return it != _conns.end() ? it->second.sent : stats{};
+    }
+
+    /// @return Listen socket the server created on the port, or `k_HSteamListenSocket_Invalid` if none.
+    auto find_listen_socket(std::uint16_t port) -> HSteamListenSocket
+    {
+        std::lock_guard lock(_mutex);
+        for (const auto& [socket, info] : _listen_sockets)
+            if (info.port == port)
+                return socket;
+        return k_HSteamListenSocket_Invalid;
+    }
+
+    /// @brief Connect a client to the listen socket.
+    /// The server sees it connecting on its next `wait()`.
+    /// @return Connection of the client, as the server sees it.
+    auto connect(HSteamListenSocket listen_socket) -> HSteamNetConnection
+    {
+        std::lock_guard lock(_mutex);
+        if (!_listen_sockets.contains(listen_socket))
+            return k_HSteamNetConnection_Invalid;
+
+        const HSteamNetConnection conn = _next_handle++;
+        _conns.emplace(conn, connection{.listen_socket = listen_socket});
+        queue_callback(conn, _conns.at(conn), k_ESteamNetworkingConnectionState_None);
+        return conn;
+    }
+
+    /// @brief Close the connection from the client side.
+    /// The server sees it closed by peer on its next `wait()`.
+    void disconnect(HSteamNetConnection conn)
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end() || it->second.state != k_ESteamNetworkingConnectionState_Connected)
+            return;
+
+        it->second.state = k_ESteamNetworkingConnectionState_ClosedByPeer;
+        queue_callback(conn, it->second, k_ESteamNetworkingConnectionState_Connected);
+    }
+
+    /// @brief Send a message from the client to the server, queuing it on the poll group of the connection.
+    /// @return Whether it's queued; it's not, if the server hasn't put the connection in a poll group yet.
+    bool send_to_server(HSteamNetConnection conn, const void* data, int size)
+    {
+        auto* msg = new fake_message();
+        if (size > 0)
+        {
+            msg->m_pData = new std::byte[(std::size_t)size];
+            msg->m_pfnFreeData = fake_message::free_buffer;
+            std::memcpy(msg->m_pData, data, (std::size_t)size);
+        }
+        msg->m_cbSize = size;
+        msg->m_conn = conn;
+        msg->m_usecTimeReceived = local_timestamp();
+
+        {
+            std::lock_guard lock(_mutex);
+            const auto it = _conns.find(conn);
+            if (it != _conns.end() && it->second.state == k_ESteamNetworkingConnectionState_Connected &&
+                it->second.poll_group != k_HSteamNetPollGroup_Invalid)
+            {
+                msg->m_nConnUserData = it->second.user_data;
+                _poll_groups.at(it->second.poll_group).push_back(msg);
+                msg = nullptr;
+                ++_wake_seq;
+            }
+        }
+
+        if (msg)
+        {
+            msg->Release();
+            return false;
+        }
+
+        _wake_cv.notify_all();
+        return true;
+    }
+
+public:
+    void acquire() override
+    {
+    }
+
+    void release() override
+    {
+    }
+
+    auto lock_polling() -> std::unique_lock<std::mutex> override
+    {
+        return std::unique_lock(_poll_mutex);
+    }
+
+    /// @brief Wait for the clients to do something, and run the callbacks of the connection status changes.
+    void wait(std::uint64_t& seen_wake_seq, int max_wait_milliseconds) override
+    {
+        std::vector<SteamNetConnectionStatusChangedCallback_t> callbacks;
+        {
+            std::unique_lock lock(_mutex);
+            _wake_cv.wait_for(lock, std::chrono::milliseconds(max_wait_milliseconds), [&] {
+                return _wake_seq != seen_wake_seq || !_pending_callbacks.empty();
+            });
+            seen_wake_seq = _wake_seq;
+            std::swap(callbacks, _pending_callbacks);
+        }
+
+        std::lock_guard poll_lock(_poll_mutex);
+        for (auto& info : callbacks)
+        {
+            status_changed_callback callback = nullptr;
+            {
+                std::lock_guard lock(_mutex);
+                if (const auto it = _listen_sockets.find(info.m_info.m_hListenSocket); it != _listen_sockets.end())
+                    callback = it->second.callback;
+            }
+            if (callback)
+                callback(&info);
+        }
+    }
+
+    void wake() override
+    {
+        {
+            std::lock_guard lock(_mutex);
+            ++_wake_seq;
+        }
+        _wake_cv.notify_all();
+    }
+
+    auto local_timestamp() -> SteamNetworkingMicroseconds override
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    auto create_listen_socket_ip(const SteamNetworkingIPAddr& addr, int config_count,
+                                 const SteamNetworkingConfigValue_t* configs) -> HSteamListenSocket override
+    {
+        status_changed_callback callback = nullptr;
+        for (int i = 0; i < config_count; ++i)
+            if (configs[i].m_eValue == k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged)
+                callback = reinterpret_cast<status_changed_callback>(configs[i].m_val.m_ptr);
+
+        std::lock_guard lock(_mutex);
+        const HSteamListenSocket socket = _next_handle++;
+        _listen_sockets.emplace(socket, listen_socket_info{.port = addr.m_port, .callback = callback});
+        return socket;
+    }
+
+    bool close_listen_socket(HSteamListenSocket socket) override
+    {
+        std::lock_guard lock(_mutex);
+        if (!_listen_sockets.erase(socket))
+            return false;
+
+        // Drop the connections accepted from it, like the GNS does
+        std::erase_if(_pending_callbacks, [socket](const SteamNetConnectionStatusChangedCallback_t& info) {
+            return info.m_info.m_hListenSocket == socket;
+        });
+        for (auto it = _conns.begin(); it != _conns.end();)
+        {
+            if (it->second.listen_socket == socket)
+            {
+                drop_received(it->first, it->second);
+                it = _conns.erase(it);
+            }
+            else
+                ++it;
+        }
+        return true;
+    }
+
+    auto create_poll_group() -> HSteamNetPollGroup override
+    {
+        std::lock_guard lock(_mutex);
+        const HSteamNetPollGroup poll_group = _next_handle++;
+        _poll_groups.emplace(poll_group, std::deque<SteamNetworkingMessage_t*>{});
+        return poll_group;
+    }
+
+    bool destroy_poll_group(HSteamNetPollGroup poll_group) override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _poll_groups.find(poll_group);
+        if (it == _poll_groups.end())
+            return false;
+
+        for (auto* msg : it->second)
+            msg->Release();
+        _poll_groups.erase(it);
+
+        for (auto& [conn, c] : _conns)
+            if (c.poll_group == poll_group)
+                c.poll_group = k_HSteamNetPollGroup_Invalid;
+        return true;
+    }
+
+    auto accept_connection(HSteamNetConnection conn) -> EResult override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end())
+            return k_EResultInvalidParam;
+        if (it->second.state != k_ESteamNetworkingConnectionState_Connecting)
+            return k_EResultInvalidState;
+
+        it->second.state = k_ESteamNetworkingConnectionState_Connected;
+        queue_callback(conn, it->second, k_ESteamNetworkingConnectionState_Connecting);
+        return k_EResultOK;
+    }
+
+    bool close_connection(HSteamNetConnection conn, int, const char*, bool) override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end())
+            return false;
+
+        drop_received(conn, it->second);
+        _conns.erase(it);
+        return true;
+    }
+
+    bool set_connection_poll_group(HSteamNetConnection conn, HSteamNetPollGroup poll_group) override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end() || !_poll_groups.contains(poll_group))
+            return false;
+
+        it->second.poll_group = poll_group;
+        return true;
+    }
+
+    bool set_connection_user_data(HSteamNetConnection conn, std::int64_t user_data) override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end())
+            return false;
+
+        it->second.user_data = user_data;
+        return true;
+    }
+
+    auto configure_connection_lanes(HSteamNetConnection conn, int, const int*, const std::uint16_t*)
+        -> EResult override
+    {
+        std::lock_guard lock(_mutex);
+        return _conns.contains(conn) ? k_EResultOK : k_EResultNoConnection;
+    }
+
+    /// @brief Status of a connection that's never behind, as the sent messages are released right away.
+    auto get_connection_real_time_status(HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t& status)
+        -> EResult override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _conns.find(conn);
+        if (it == _conns.end())
+            return k_EResultNoConnection;
+
+        status = SteamNetConnectionRealTimeStatus_t{};
+        status.m_eState = it->second.state;
+        status.m_flConnectionQualityLocal = 1;
+        status.m_flConnectionQualityRemote = 1;
+        return k_EResultOK;
+    }
+
+    auto receive_messages_on_poll_group(HSteamNetPollGroup poll_group, SteamNetworkingMessage_t** msgs,
+                                        int max_msgs) -> int override
+    {
+        std::lock_guard lock(_mutex);
+        const auto it = _poll_groups.find(poll_group);
+        if (it == _poll_groups.end())
+            return -1;
+
+        auto& queue = it->second;
+        int count = 0;
+        for (; count < max_msgs && !queue.empty(); ++count)
+        {
+            msgs[count] = queue.front();
+            queue.pop_front();
+        }
+        return count;
+    }
+
+    auto allocate_message(int size) -> SteamNetworkingMessage_t* override
+    {
+        auto* msg = new fake_message();
+        if (size > 0)
+        {
+            msg->m_pData = new std::byte[(std::size_t)size];
+            msg->m_pfnFreeData = fake_message::free_buffer;
+        }
+        msg->m_cbSize = size;
+        return msg;
+    }
+
+    /// @brief Count the messages to the connected clients, hand them to the sink, and release them.
+    void send_messages(int msg_count, SteamNetworkingMessage_t* const* msgs) override
+    {
+        {
+            std::lock_guard lock(_mutex);
+            for (int i = 0; i < msg_count; ++i)
+            {
+                const auto it = _conns.find(msgs[i]->m_conn);
+                if (it == _conns.end() || it->second.state != k_ESteamNetworkingConnectionState_Connected)
+                    continue;
+
+                ++it->second.sent.messages_sent;
+                it->second.sent.bytes_sent += (std::uint64_t)msgs[i]->m_cbSize;
+                ++_stats.messages_sent;
+                _stats.bytes_sent += (std::uint64_t)msgs[i]->m_cbSize;
+
+                if (_sink)
+                    _sink(*msgs[i]);
+            }
+        }
+
+        for (int i = 0; i < msg_count; ++i)
+            msgs[i]->Release();
+    }
+
+private:
+    void queue_callback(HSteamNetConnection conn, const connection& c, ESteamNetworkingConnectionState old_state)
+    {
+        SteamNetConnectionStatusChangedCallback_t info{};
+        info.m_hConn = conn;
+        info.m_eOldState = old_state;
+        info.m_info.m_hListenSocket = c.listen_socket;
+        info.m_info.m_eState = c.state;
+        info.m_info.m_nUserData = c.user_data;
+        if (c.state == k_ESteamNetworkingConnectionState_ClosedByPeer)
+            info.m_info.m_eEndReason = k_ESteamNetConnectionEnd_App_Generic;
+
+        _pending_callbacks.push_back(info);
+        ++_wake_seq;
+        _wake_cv.notify_all();
+    }
+
+    // Release the messages of the connection not received yet
+    void drop_received(HSteamNetConnection conn, const connection& c)
+    {
+        const auto it = _poll_groups.find(c.poll_group);
+        if (it == _poll_groups.end())
+            return;
+
+        std::erase_if(it->second, [conn](SteamNetworkingMessage_t* msg) {
+            if (msg->m_conn != conn)
+                return false;
+            msg->Release();
+            return true;
+        });
+    }
+};
@@ -0,0 +1,227 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/// @brief Monotonic counter, updated by one thread and read by any thread.
+class counter
+{
+private:
+    std::atomic<std::uint64_t> _value{0};
+
+public:
+    void add(std::uint64_t amount = 1)
+    {
+        _value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    auto value() const -> std::uint64_t
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        _value.store(0, std::memory_order_relaxed);
+    }
+};
+
+/// @brief Value that goes up and down, updated by one thread and read by any thread.
+class gauge
+{
+private:
+    std::atomic<std::int64_t> _value{0};
+
+public:
+    void set(std::int64_t value)
+    {
+        _value.store(value, std::memory_order_relaxed);
+    }
+
+    void add(std::int64_t amount)
+    {
+        _value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    auto value() const -> std::int64_t
+    {
+        return _value.load(std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        set(0);
+    }
+};
+
+/// @brief HDR-style histogram of non-negative integer values, e.g. microseconds.
+///
+/// Values below `2^SUB_BUCKET_BITS` are recorded exactly, and the larger ones with `SUB_BUCKET_BITS - 1` significant
+/// bits, i.e. the relative error is below 1/64. Values over `MAX_VALUE` are clamped.
+///
+/// Recording is a few relaxed atomic increments, so it's cheap on the recording thread,
+/// and any thread can read the summary meanwhile.
+class histogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 7;
+    static constexpr int MAX_VALUE_BITS = 40;
+    static constexpr std::uint64_t MAX_VALUE = (std::uint64_t(1) << MAX_VALUE_BITS) - 1;
+
+    struct summary
+    {
+        std::uint64_t count;
+        double mean;
+        std::uint64_t max;
+        std::uint64_t p50;
+        std::uint64_t p90;
+        std::uint64_t p99;
+        std::uint64_t p999;
+    };
+
+private:
+    static constexpr std::size_t SUB_BUCKET_COUNT = std::size_t(1) << SUB_BUCKET_BITS;
+    static constexpr std::size_t HALF_SUB_BUCKET_COUNT = SUB_BUCKET_COUNT / 2;
+    static constexpr std::size_t BUCKET_COUNT =
+        SUB_BUCKET_COUNT + (MAX_VALUE_BITS - SUB_BUCKET_BITS) * HALF_SUB_BUCKET_COUNT;
+
+private:
+    std::array<std::atomic<std::uint64_t>, BUCKET_COUNT> _buckets{};
+    std::atomic<std::uint64_t> _count{0};
+    std::atomic<std::uint64_t> _sum{0};
+    std::atomic<std::uint64_t> _max{0};
+
+public:
+    void record(std::uint64_t value)
+    {
+        value = std::min(value, MAX_VALUE);
+
+        _buckets[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        _count.fetch_add(1, std::memory_order_relaxed);
+        _sum.fetch_add(value, std::memory_order_relaxed);
+        if (value > _max.load(std::memory_order_relaxed))
+            _max.store(value, std::memory_order_relaxed);
+    }
+
+    void reset()
+    {
+        for (auto& bucket : _buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        _count.store(0, std::memory_order_relaxed);
+        _sum.store(0, std::memory_order_relaxed);
+        _max.store(0, std::memory_order_relaxed);
+    }
+
+    /// @brief Summarize the recorded values.
+    /// The percentiles are the highest value of the bucket they fall in, so they never under-report.
+    auto get_summary() const -> summary
+    {
+        std::array<std::uint64_t, BUCKET_COUNT> buckets;
+        std::uint64_t count = 0;
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            buckets[i] = _buckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+
+        const std::uint64_t max = _max.load(std::memory_order_relaxed);
+        auto percentile = [&](double p) -> std::uint64_t {
+            if (count == 0)
+                return 0;
+
+            const auto rank = std::max<std::uint64_t>(1, (std::uint64_t)((double)count * p + 0.5));
+            std::uint64_t seen = 0;
+            for (std::size_t i = 0; i < BUCKET_COUNT; ++i)
+            {
+                seen += buckets[i];
+                if (seen >= rank)
+                    return std::min(bucket_highest_value(i), max);
+            }
+            return max;
+        };
+
+        const std::uint64_t total = _count.load(std::memory_order_relaxed);
+        return summary{
+            .count = count,
+            .mean = total ? (double)_sum.load(std::memory_order_relaxed) / (double)total : 0.0,
+            .max = max,
+            .p50 = percentile(0.5),
+            .p90 = percentile(0.9),
+            .p99 = percentile(0.99),
+            .p999 = percentile(0.999),
+        };
+    }
+
+private:
+    static auto bucket_index(std::uint64_t value) -> std::size_t
+    {
+        if (value < SUB_BUCKET_COUNT)
+            return (std::size_t)value;
+
+        // Keep the top `SUB_BUCKET_BITS` bits, whose highest bit is always set
+        const int shift = std::bit_width(value) - SUB_BUCKET_BITS;
+        const auto top = (std::size_t)(value >> shift);
+        return SUB_BUCKET_COUNT + (std::size_t)(shift - 1) * HALF_SUB_BUCKET_COUNT + (top - HALF_SUB_BUCKET_COUNT);
+    }
+
+    static auto bucket_highest_value(std::size_t index) -> std::uint64_t
+    {
+        if (index < SUB_BUCKET_COUNT)
+            return index;
+
+        const int shift = (int)((index - SUB_BUCKET_COUNT) / HALF_SUB_BUCKET_COUNT) + 1;
+        const std::uint64_t top = (index - SUB_BUCKET_COUNT) % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+        return ((top + 1) << shift) - 1;
+    }
+};
+
+/// @brief Writes metrics in a Prometheus-like text format, one sample per line:
+/// `name{label="value",...} sample`
+class metrics_text
+{
+private:
+    std::string _text;
+
+public:
+    void add(std::string_view name, std::string_view labels, std::uint64_t value)
+    {
+        std::format_to(std::back_inserter(_text), "{}{{{}}} {}\n", name, labels, value);
+    }
+
+    void add(std::string_view name, std::string_view labels, std::int64_t value)
+    {
+        std::format_to(std::back_inserter(_text), "{}{{{}}} {}\n", name, labels, value);
+    }
+
+    void add(std::string_view name, std::string_view labels, const histogram::summary& summary)
+    {
+        std::format_to(std::back_inserter(_text), "{}_count{{{}}} {}\n", name, labels, summary.count);
+        std::format_to(std::back_inserter(_text), "{}_mean{{{}}} {:.1f}\n", name, labels, summary.mean);
+        std::format_to(std::back_inserter(_text), "{}_max{{{}}} {}\n", name, labels, summary.max);
+
+        const std::pair<std::string_view, std::uint64_t> quantiles[] = {
+            {"0.5", summary.p50},
+            {"0.9", summary.p90},
+            {"0.99", summary.p99},
+            {"0.999", summary.p999},
+        };
+        for (const auto& [quantile, value] : quantiles)
+            std::format_to(std::back_inserter(_text), "{}{{{},quantile=\"{}\"}} {}\n", name, labels, quantile, value);
+    }
+
+    auto str() const -> const std::string&
+    {
+        return _text;
+    }
+};
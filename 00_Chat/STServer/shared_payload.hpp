@@ -0,0 +1,95 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "buffer_pool.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/// @brief Ref-counted payload, which can be shared by multiple outgoing `SteamNetworkingMessage_t`s.
+///
+/// This lets you serialize a message once, and send it to many connections without copying it for each one:
+/// every message allocated with `ISteamNetworkingUtils::AllocateMessage(0)` points to this payload,
+/// and GNS releases a reference via `m_pfnFreeData` when it's done with a message.
+///
+/// The payloads are allocated from `buffer_pool::shared()`, so the last release recycles the buffer.
+class shared_payload
+{
+private:
+    std::atomic<std::uint32_t> _ref_count;
+    const std::uint32_t _size;
+
+private:
+    explicit shared_payload(std::uint32_t size) : _ref_count(1), _size(size)
+    {
+    }
+
+    ~shared_payload() = default;
+
+public:
+    shared_payload(const shared_payload&) = delete;
+    shared_payload& operator=(const shared_payload&) = delete;
+
+    /// @brief Allocate a payload of `size` bytes, with a single reference owned by the caller.
+    static auto create(std::uint32_t size) -> shared_payload*
+    {
+        void* mem = buffer_pool::shared().allocate(sizeof(shared_payload) + size);
+        return new (mem) shared_payload(size);
+    }
+
+    auto data() -> std::byte*
+    {
+        return reinterpret_cast<std::byte*>(this + 1);
+    }
+
+    auto size() const -> std::uint32_t
+    {
+        return _size;
+    }
+
+    void add_ref()
+    {
+        _ref_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @brief Release a reference, and free the payload if it was the last one.
+    /// This might be called on any thread, as GNS frees the sent messages on whichever thread it's running.
+    void release()
+    {
+        if (_ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            const std::size_t alloc_size = sizeof(shared_payload) + _size;
+            this->~shared_payload();
+            buffer_pool::shared().deallocate(this, alloc_size);
+        }
+    }
+
+    /// @brief Point an outgoing message to this payload, adding a reference owned by the message.
+    /// @param msg Message allocated with `ISteamNetworkingUtils::AllocateMessage(0)`.
+    /// @param conn Connection to send the message to.
+    /// @param send_flags Send flags, e.g. `k_nSteamNetworkingSend_ReliableNoNagle`.
+    /// @param lane Lane to send on, configured with `ISteamNetworkingSockets::ConfigureConnectionLanes()`.
+    void attach(SteamNetworkingMessage_t& msg, HSteamNetConnection conn, int send_flags, std::uint16_t lane = 0)
+    {
+        add_ref();
+
+        msg.m_conn = conn;
+        msg.m_nFlags = send_flags;
+        msg.m_idxLane = lane;
+        msg.m_pData = data();
+        msg.m_cbSize = (int)_size;
+        msg.m_nUserData = (int64)(std::intptr_t)this;
+        msg.m_pfnFreeData = free_data;
+    }
+
+private:
+    static void free_data(SteamNetworkingMessage_t* msg)
+    {
+        reinterpret_cast<shared_payload*>((std::intptr_t)msg->m_nUserData)->release();
+    }
+};
@@ -1,438 +1,312 @@
 // SPDX-License-Identifier: 0BSD
 
-#include "../Proto/ChatProtocol.pb.h"
+#include "st_chat_server.hpp"
 
-#include <steam/isteamnetworkingutils.h>
-#include <steam/steamnetworkingsockets.h>
-#include <steam/steamnetworkingtypes.h>
+#include "cli_args.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "transport_quality.hpp"
 
-#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <filesystem>
 #include <format>
+#include <fstream>
 #include <iostream>
-#include <stdexcept>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
 
-class st_chat_server
+/// @brief Metrics of all the servers in the text format.
+static auto collect_metrics(const std::vector<std::unique_ptr<st_chat_server>>& servers, std::uint16_t first_port)
+    -> std::string
 {
-public:
-    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
-    static constexpr int MAX_MESSAGES_PER_RECEIVE = 100;
-
-private:
-    struct client_info
-    {
-        std::string name;
-    };
-
-private:
-    static std::atomic<st_chat_server*> _instance;
+    metrics_text text;
+    for (std::size_t i = 0; i < servers.size(); ++i)
+        servers[i]->write_metrics(text, std::format("server=\"{}\"", first_port + i));
 
-    bool _disposed = true;
+    const auto log_stats = logger::shared().get_stats();
+    text.add("chat_log_records_written_total", "", log_stats.written);
+    text.add("chat_log_records_dropped_total", "", log_stats.dropped);
 
-    bool _gns_initialized = false;
+    return text.str();
+}
 
-    HSteamNetPollGroup _poll_group = k_HSteamNetPollGroup_Invalid;
-    HSteamListenSocket _listen_socket = k_HSteamListenSocket_Invalid;
+/// @brief Print the transport quality of the clients of a server,
+/// and whether their latency comes mostly from the server loop or from their links.
+static void print_transport_quality(const st_chat_server& server, std::uint16_t port)
+{
+    const auto transport = server.get_transport_quality();
+    if (transport.sweeps == 0)
+    {
+        std::cout << std::format("[{}] Transport quality: no sweep finished yet", port) << std::endl;
+        return;
+    }
 
-    std::unordered_map<std::uint32_t, client_info> _clients;
+    std::cout << std::format("[{}] Ping p50/p90/p99/max: {}/{}/{}/{}ms, local loss p50/p99: {}/{}‰, "
+                             "remote loss p50/p99: {}/{}‰ ({} connections)",
+                             port, transport.ping_ms.p50, transport.ping_ms.p90, transport.ping_ms.p99,
+                             transport.ping_ms.max, transport.local_loss_per_mille.p50,
+                             transport.local_loss_per_mille.p99, transport.remote_loss_per_mille.p50,
+                             transport.remote_loss_per_mille.p99, transport.ping_ms.count)
+              << std::endl;
+    std::cout << std::format("[{}] Send rate p50: {}B/s, pending reliable p50/p99: {}/{}B, "
+                             "pending unreliable p50/p99: {}/{}B, queue time p50/p99: {}/{}us",
+                             port, transport.send_rate_bytes.p50, transport.pending_reliable_bytes.p50,
+                             transport.pending_reliable_bytes.p99, transport.pending_unreliable_bytes.p50,
+                             transport.pending_unreliable_bytes.p99, transport.queue_time_us.p50,
+                             transport.queue_time_us.p99)
+              << std::endl;
+
+    // Compare the time a chat spends in the server with the one-way trip of a link, both at p99
+    const auto& metrics = server.get_metrics();
+    const auto server_us = metrics.receive_to_send_latency_us.get_summary().p99;
+    const auto tick_us = metrics.tick_duration_us.get_summary().p99;
+    const auto link_us = transport.ping_ms.p99 * 1000 / 2 + transport.queue_time_us.p99;
+    std::cout << std::format("[{}] Latency p99: server {}us (loop pass {}us), client link ~{}us one way "
+                             "(incl. send queue) => mostly from the {}",
+                             port, server_us, tick_us, link_us, server_us > link_us ? "server loop" : "client links")
+              << std::endl;
+
+    for (const auto& outlier : transport.outliers)
+    {
+        std::cout << std::format("[{}]   Outlier client #{}: ping {}ms, local loss {}‰, remote loss {}‰, "
+                                 "{}B pending reliable, queue time {}us",
+                                 port, outlier.conn, outlier.ping_ms, outlier.local_loss_per_mille,
+                                 outlier.remote_loss_per_mille, outlier.pending_reliable_bytes, outlier.queue_time_us)
+                  << std::endl;
+    }
+}
 
-    std::atomic<bool> _quit_requested;
-    std::thread _server_thread;
+/// @brief Periodically writes the metrics of the servers to a file, on its own thread.
+/// The file is replaced atomically, so a reader never sees a partially written one.
+class metrics_dumper
+{
+private:
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _quit_requested = false;
+    std::thread _thread;
 
 public:
-    /// @brief Constructor to prevent multiple instance of `st_chat_server`.
-    /// This is due to GNS's callbacks using function pointers.
-    /// I need to find a way to remove this limitation in the future.
-    st_chat_server()
+    metrics_dumper(const std::vector<std::unique_ptr<st_chat_server>>& servers, std::uint16_t first_port,
+                   std::filesystem::path path, std::chrono::seconds interval)
     {
-        st_chat_server* expected = nullptr;
-        if (!_instance.compare_exchange_strong(expected, this, std::memory_order_relaxed))
-            throw std::logic_error("There are multiple `st_chat_server` instances");
+        _thread = std::thread([this, &servers, first_port, path = std::move(path), interval] {
+            std::unique_lock lock(_mutex);
+            while (!_cv.wait_for(lock, interval, [this] { return _quit_requested; }))
+                dump(collect_metrics(servers, first_port), path);
+        });
     }
 
-    ~st_chat_server()
+    ~metrics_dumper()
     {
-        _instance.store(nullptr, std::memory_order_relaxed);
+        {
+            std::lock_guard lock(_mutex);
+            _quit_requested = true;
+        }
+        _cv.notify_one();
+        _thread.join();
     }
 
-public:
-    /// @brief Start the server with specified port.
-    /// @param port Port to listen.
-    /// @return Whether the server has been started to run, or errored.
-    bool start(std::uint16_t port)
+private:
+    static void dump(const std::string& text, const std::filesystem::path& path)
     {
-        _disposed = false;
-
-        try
+        auto temp_path = path;
+        temp_path += ".tmp";
         {
-            // Initialize `GameNetworkingSockets`
-            SteamDatagramErrMsg err_msg;
-            _gns_initialized = GameNetworkingSockets_Init(nullptr, err_msg);
-            if (!_gns_initialized)
-                throw std::runtime_error(err_msg);
-
-            // Prepare poll group
-            _poll_group = SteamNetworkingSockets()->CreatePollGroup();
-
-            // Manage connected clients' info with `std::unordered_map`.
-            // Note that a client might not logged in yet.
-            _clients.clear();
-
-            // Setup configuration used for listen socket
-            SteamNetworkingConfigValue_t configs[1]{};
-            configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
-                              (void*)on_connection_status_changed);
-
-            // Start listening
-            SteamNetworkingIPAddr addr{};
-            addr.m_port = port;
-            _listen_socket = SteamNetworkingSockets()->CreateListenSocketIP(addr, 1, configs);
-            if (_listen_socket == k_HSteamListenSocket_Invalid)
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.write(text.data(), (std::streamsize)text.size()))
             {
-                throw std::runtime_error("Failed to create a listen socket");
+                logger::warning("Failed to write the metrics to {}", temp_path.string());
+                return;
             }
-
-            // Create the server loop as a seperate thread
-            _quit_requested.store(false, std::memory_order_relaxed);
-            _server_thread = std::thread(&st_chat_server::server_loop, this);
         }
-        catch (const std::exception& ex)
-        {
-            std::cout << "Failed to start st_chat_server: " << ex.what() << '\n';
 
-            dispose();
-
-            return false;
-        }
-
-        return true;
+        std::error_code ec;
+        std::filesystem::rename(temp_path, path, ec);
+        if (ec)
+            logger::warning("Failed to replace the metrics file {}: {}", path.string(), ec.message());
     }
+};
 
-    /// @brief Stop the server.
-    /// @param linger_milliseconds Milliseconds to wait before dropping connections.
-    /// This can be useful if you want to send a goodbye message or similar.
-    void stop(int linger_milliseconds = 0)
-    {
-        if (_disposed)
-            return;
-
-        std::cout << "Stopping the server loop..." << std::endl;
-
-        // Stop the server loop
-        _quit_requested.store(true, std::memory_order_relaxed);
+int main(int argc, char** args)
+{
+    std::cout << "GNS-Practice #00: Chat" << std::endl;
+    std::cout << "Single-threaded chat server in C++ with GameNetworkingSockets\n" << std::endl;
 
-        std::cout << "Closing connections..." << std::endl;
+    // Parse port and options from `args`
+    // Usage: st_chat_server [port] [--servers=<count>] [--batch=<messages>] [--drain-budget-us=<microseconds>]
+    //                       [--no-drain] [--no-arena] [--no-rate-limits] [--batch-delay-us=<microseconds>]
+    //                       [--slow-consumer=<drop|summarize|disconnect>]
+    //                       [--metrics-file=<path>] [--metrics-interval-s=<seconds>] [--capture=<path>]
+    std::uint16_t port = st_chat_server::DEFAULT_SERVER_PORT;
+    int server_count = 1;
+    st_chat_server::settings settings;
+    // Empty to not dump the metrics
+    std::string metrics_file = "st_chat_server.metrics";
+    std::chrono::seconds metrics_interval(10);
+    // Empty to not capture the traffic
+    std::string capture_file;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = args[i];
 
-        // Close all the connections with linger enabled
-        for (const auto& client : _clients)
+        if (arg == "--no-drain")
         {
-            SteamNetworkingSockets()->CloseConnection(client.first, 0, "Server shutdown", true);
+            settings.drain_until_empty = false;
         }
-
-        // Wait for the server loop task to stop
-        _server_thread.join();
-
-        // Wait for the linger for a short period of time
-        if (linger_milliseconds > 0)
-            std::this_thread::sleep_for(std::chrono::milliseconds(linger_milliseconds));
-
-        // This should be AFTER lingering, because closing listen socket drops all connections accepted from it
-        SteamNetworkingSockets()->CloseListenSocket(_listen_socket);
-
-        dispose();
-    }
-
-    /// @brief Disposes the server synchronously.
-    /// If it was not stopped, it will block to stop.
-    void dispose()
-    {
-        if (!_disposed)
+        else if (arg == "--no-arena")
         {
-            _quit_requested.store(true, std::memory_order_relaxed);
-            if (_server_thread.joinable())
-                _server_thread.join();
-
-            if (_listen_socket != k_HSteamListenSocket_Invalid)
-            {
-                SteamNetworkingSockets()->CloseListenSocket(_listen_socket);
-                _listen_socket = k_HSteamListenSocket_Invalid;
-            }
-
-            _clients.clear();
-
-            if (_poll_group != k_HSteamNetPollGroup_Invalid)
+            settings.use_protobuf_arena = false;
+        }
+        else if (arg == "--no-rate-limits")
+        {
+            settings.chat_rate_limit = {};
+            settings.name_change_rate_limit = {};
+            settings.room_rate_limit = {};
+        }
+        else if (arg.starts_with("--servers="))
+        {
+            long count;
+            if (!parse_long(arg.substr(arg.find('=') + 1), count) || count <= 0 || count > 1024)
             {
-                SteamNetworkingSockets()->DestroyPollGroup(_poll_group);
-                _poll_group = k_HSteamNetPollGroup_Invalid;
+                std::cout << "Invalid server count: " << arg << std::endl;
+                return 0;
             }
-
-            _disposed = true;
+            server_count = (int)count;
         }
-    }
-
-private:
-    /// @brief Receive data and run callbacks here.
-    void server_loop()
-    {
-        while (!_quit_requested.load(std::memory_order_relaxed))
+        else if (arg.starts_with("--batch="))
         {
-            SteamNetworkingSockets()->RunCallbacks();
-
-            SteamNetworkingMessage_t* msgs[MAX_MESSAGES_PER_RECEIVE];
-            int received_msg_count =
-                SteamNetworkingSockets()->ReceiveMessagesOnPollGroup(_poll_group, msgs, MAX_MESSAGES_PER_RECEIVE);
-            if (received_msg_count == -1)
+            long batch;
+            if (!parse_long(arg.substr(arg.find('=') + 1), batch) || batch <= 0 || batch > 65536)
             {
-                throw std::runtime_error("receive msg failed");
+                std::cout << "Invalid batch size: " << arg << std::endl;
+                return 0;
             }
+            settings.max_messages_per_receive = (int)batch;
+        }
+        else if (arg.starts_with("--slow-consumer="))
+        {
+            const std::string_view policy = arg.substr(arg.find('=') + 1);
+            if (policy == "drop")
+                settings.slow_consumer = st_chat_server::slow_consumer_policy::drop;
+            else if (policy == "summarize")
+                settings.slow_consumer = st_chat_server::slow_consumer_policy::summarize;
+            else if (policy == "disconnect")
+                settings.slow_consumer = st_chat_server::slow_consumer_policy::disconnect;
             else
             {
-                for (int i = 0; i < received_msg_count; ++i)
-                {
-                    on_message(*msgs[i]);
-
-                    msgs[i]->Release();
-                }
+                std::cout << "Invalid slow consumer policy: " << arg << std::endl;
+                return 0;
             }
-
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
         }
-    }
-
-    /// @brief Callback that's called from the GNS when connection status changed for any client.
-    /// This function is static, due to GNS's callbacks using function pointers;
-    /// I need to find a way to remove this limitation in the future.
-    /// @param info Connection status changed info.
-    static void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
-    {
-        auto& server = *_instance.load(std::memory_order_relaxed);
-
-        switch (info->m_info.m_eState)
+        else if (arg.starts_with("--batch-delay-us="))
         {
-        case k_ESteamNetworkingConnectionState_None:
-            // This is when you destroy the connection.
-            // Nothing to do here.
-            break;
-
-        case k_ESteamNetworkingConnectionState_Connecting: {
-
-            // Accept the connection.
-            // You could also close the connection right away.
-            EResult accept_result = SteamNetworkingSockets()->AcceptConnection(info->m_hConn);
-
-            // If accept failed, clean up the connection.
-            if (accept_result != k_EResultOK)
+            long delay;
+            if (!parse_long(arg.substr(arg.find('=') + 1), delay) || delay < 0)
             {
-                SteamNetworkingSockets()->CloseConnection(info->m_hConn, 0, "Accept failure", false);
-                std::cout << "Accept failed with " << accept_result << std::endl;
-                break;
-            }
-
-            // Add new client to `clients` map
-            // It doesn't have a name yet, which means it's not properly logged in.
-            //
-            // Note that we do this BEFORE assign it to the poll group.
-            // If we do the opposite, and if the message callback runs on a seperate thread,
-            // it might not find this client from `clients` map, because it's not added at that point.
-            //
-            // But actually, it's a single-threaded code now, so it doesn't matter for now.
-            server._clients.try_emplace(info->m_hConn, client_info{});
-
-            // Assign new client to the poll group
-            if (!SteamNetworkingSockets()->SetConnectionPollGroup(info->m_hConn, server._poll_group))
-            {
-                server._clients.erase(info->m_hConn);
-                SteamNetworkingSockets()->CloseConnection(info->m_hConn, 0, "Poll group assign failure", false);
-
-                std::cout << "Failed to assign poll group" << std::endl;
-                break;
+                std::cout << "Invalid batch delay: " << arg << std::endl;
+                return 0;
             }
-
-            std::cout << std::format("New client #{} connected!", info->m_hConn) << std::endl;
-
-            break;
-        }
-
-        case k_ESteamNetworkingConnectionState_ClosedByPeer:
-        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally: {
-            // Connection changed callbacks are dispatched in FIFO order.
-
-            // Get the client from `clients`
-            client_info& client = server._clients[info->m_hConn];
-
-            // Print the reason of connection close
-            SteamNetConnectionInfo_t& conn_info = info->m_info;
-            std::string_view client_name = "(not logged-in client)";
-            if (!client.name.empty())
-                client_name = client.name;
-            std::string_view state = conn_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
-                                         ? "closed by peer"
-                                         : "problem detected locally";
-            std::string_view desc =
-                conn_info.m_szConnectionDescription ? conn_info.m_szConnectionDescription : "(Invalid desc)";
-            std::string_view dbg = conn_info.m_szEndDebug ? conn_info.m_szEndDebug : "(Invalid dbg)";
-            char addr_str[SteamNetworkingIPAddr::k_cchMaxString];
-            conn_info.m_addrRemote.ToString(addr_str, sizeof addr_str, true);
-
-            std::cout << std::format("{} ({}) {} ({}), reason {}: {}", client_name, addr_str, desc, state,
-                                     conn_info.m_eEndReason, dbg)
-                      << std::endl;
-
-            // Remove it from the clients map
-            server._clients.erase(info->m_hConn);
-
-            // Don't forget to clean up the connection!
-            SteamNetworkingSockets()->CloseConnection(info->m_hConn, 0, nullptr, false);
-
-            break;
+            settings.batch_delay = std::chrono::microseconds(delay);
         }
-
-        case k_ESteamNetworkingConnectionState_Connected:
-            // Callback after accepting the connection.
-            // Nothing to do here, as we're the server.
-            break;
-        }
-    }
-
-    /// @brief Callback that's called when a message arrived from any client.
-    void on_message(const SteamNetworkingMessage_t& net_msg)
-    {
-        // Ignore the empty message.
-        // In this case, `netMsg.data` is nullptr
-        if (net_msg.m_cbSize == 0)
+        else if (arg.starts_with("--metrics-file="))
         {
-            std::cout << "Client sent an empty message" << std::endl;
-            return;
+            metrics_file = arg.substr(arg.find('=') + 1);
         }
-
-        // Unmarshall the protobuf message
-        GNSPrac::Chat::ChatProtocol msg;
-        if (!msg.ParseFromArray(net_msg.m_pData, net_msg.m_cbSize))
+        else if (arg.starts_with("--capture="))
         {
-            std::cout << "Client sent an invalid message" << std::endl;
-            return;
+            capture_file = arg.substr(arg.find('=') + 1);
         }
-
-        // Get the client from `clients` map.
-        // It must exist in the map, because we added it on `ConnectionState::Connecting`
-        client_info& client = _clients[net_msg.m_conn];
-
-        // Handle the message based on its type
-        switch (msg.msg_case())
+        else if (arg.starts_with("--metrics-interval-s="))
         {
-            using msg_case = GNSPrac::Chat::ChatProtocol::MsgCase;
-
-        case msg_case::kChat: {
-            // We could reuse the same `msg`, but we'll just create another one to demonstrate.
-            // I'm omitting checks for simplicity, but you should always validate a client message.
-            GNSPrac::Chat::ChatProtocol response;
-            auto& chat = *response.mutable_chat();
-            *chat.mutable_sender_name() = client.name.empty() ? std::format("Guest#{}", net_msg.m_conn) : client.name;
-            *chat.mutable_content() = msg.chat().content();
-
-            // Serialize the response to a byte vector.
-            // In real use case, you would get this from a pool.
-            const std::uint32_t response_size = (std::uint32_t)response.ByteSizeLong();
-            std::vector<std::byte> response_vec(response_size);
-            response.SerializeToArray(response_vec.data(), response_size);
-
-            // Propagate the response to other clients.
-            for (const auto& other_client : _clients)
+            long interval;
+            if (!parse_long(arg.substr(arg.find('=') + 1), interval) || interval <= 0)
             {
-                const auto other_conn = other_client.first;
-
-                // Ignore itself
-                if (other_conn != net_msg.m_conn)
-                {
-                    SteamNetworkingSockets()->SendMessageToConnection(other_conn, response_vec.data(), response_size,
-                                                                      k_nSteamNetworkingSend_ReliableNoNagle, nullptr);
-                }
+                std::cout << "Invalid metrics interval: " << arg << std::endl;
+                return 0;
             }
-
-            // Print the chat message on the server side, too.
-            std::cout << std::format("{}: {}", response.chat().sender_name(), response.chat().content()) << std::endl;
-            break;
+            metrics_interval = std::chrono::seconds(interval);
         }
-
-        case msg_case::kNameChange: {
-            // Set the new name if not null
-            if (msg.has_name_change() && !msg.name_change().name().empty())
+        else if (arg.starts_with("--drain-budget-us="))
+        {
+            long budget;
+            if (!parse_long(arg.substr(arg.find('=') + 1), budget) || budget < 0)
             {
-                client.name = msg.name_change().name();
-                std::cout << std::format("Client #{} changed their name to {}", net_msg.m_conn, client.name)
-                          << std::endl;
+                std::cout << "Invalid drain budget: " << arg << std::endl;
+                return 0;
             }
-
-            // Prepare the response to the client about their current name
-            GNSPrac::Chat::ChatProtocol response;
-            auto& chat = *response.mutable_chat();
-            *chat.mutable_sender_name() = "Server";
-            *chat.mutable_content() = std::format(
-                "Your name is now {}", client.name.empty() ? std::format("Guest#{}", net_msg.m_conn) : client.name);
-
-            // Serialize the response to a byte vector.
-            // In real use case, you would get this from a pool.
-            const std::uint32_t response_size = (std::uint32_t)response.ByteSizeLong();
-            std::vector<std::byte> response_vec(response_size);
-            response.SerializeToArray(response_vec.data(), response_size);
-
-            // Notify to the client about their current name
-            SteamNetworkingSockets()->SendMessageToConnection(net_msg.m_conn, response_vec.data(), response_size,
-                                                              k_nSteamNetworkingSend_ReliableNoNagle, nullptr);
-            break;
+            settings.drain_budget = std::chrono::microseconds(budget);
         }
-
-        default:
-            // Client shouldn't send other type of messages
-            std::cout << std::format("Client sent an invalid message type: {}", (int)msg.msg_case()) << std::endl;
-            break;
+        else
+        {
+            long parsed_port;
+            if (!parse_long(arg, parsed_port) || parsed_port < 0 || parsed_port >= 65536)
+            {
+                std::cout << "Invalid port: " << arg << std::endl;
+                return 0;
+            }
+            port = (std::uint16_t)parsed_port;
         }
     }
-};
-
-std::atomic<st_chat_server*> st_chat_server::_instance = nullptr;
-
-int main(int argc, char** args)
-{
-    std::cout << "GNS-Practice #00: Chat" << std::endl;
-    std::cout << "Single-threaded chat server in C++ with GameNetworkingSockets\n" << std::endl;
 
-    // Parse port from `args`
-    std::uint16_t port = st_chat_server::DEFAULT_SERVER_PORT;
+    if (port + server_count - 1 >= 65536)
+    {
+        std::cout << std::format("Not enough ports for {} servers from {}", server_count, port) << std::endl;
+        return 0;
+    }
 
-    if (argc >= 2)
+    if (server_count == 1)
+        std::cout << "Server port: " << port << '\n' << std::endl;
+    else
+        std::cout << std::format("Server ports: {}-{}\n", port, port + server_count - 1) << std::endl;
+    std::cout << std::format("Receive batch: {}, drain until empty: {}, drain budget: {}us, chat batch delay: {}us, "
+                             "protobuf arena: {}, chat rate limit: {} msg/s, {} bytes/s\n",
+                             settings.max_messages_per_receive, settings.drain_until_empty,
+                             settings.drain_budget.count(), settings.batch_delay.count(), settings.use_protobuf_arena,
+                             settings.chat_rate_limit.messages_per_second, settings.chat_rate_limit.bytes_per_second)
+              << std::endl;
+
+    // Start the servers with specified ports.
+    // Each server runs independently on its own thread, sharing the GNS in this process.
+    std::vector<std::unique_ptr<st_chat_server>> servers;
+    for (int i = 0; i < server_count; ++i)
     {
-        char* end;
-        long parsed_port = std::strtol(args[1], &end, 0);
-        if (parsed_port < 0 || parsed_port >= 65536)
+        // Each server captures into its own file, suffixed with its port if there are many
+        if (!capture_file.empty())
         {
-            std::cout << "Invalid port: " << args[1] << std::endl;
-            return 0;
+            settings.capture_path = server_count == 1 ? capture_file : std::format("{}.{}", capture_file, port + i);
+            std::cout << std::format("Capturing the traffic to port {} into {}", port + i, settings.capture_path)
+                      << std::endl;
         }
-        else
+
+        auto& server = *servers.emplace_back(std::make_unique<st_chat_server>());
+        if (!server.start((std::uint16_t)(port + i), settings))
         {
-            port = (std::uint16_t)parsed_port;
+            std::cout << "Too bad..." << std::endl;
+            return 0;
         }
     }
 
-    std::cout << "Server port: " << port << '\n' << std::endl;
-
-    // Start the server with specified port
-    st_chat_server server;
-    if (!server.start(port))
+    std::optional<metrics_dumper> dumper;
+    if (!metrics_file.empty())
     {
-        std::cout << "Too bad..." << std::endl;
-        return 0;
+        dumper.emplace(servers, port, metrics_file, metrics_interval);
+        std::cout << std::format("Dumping the metrics to {} every {}s", metrics_file, metrics_interval.count())
+                  << std::endl;
     }
 
-    std::cout << "Server started, type /quit to quit" << std::endl;
+    std::cout << "Server started, type /stats to see the stats, /quit to quit" << std::endl;
 
     while (true)
     {
@@ -444,12 +318,74 @@ int main(int argc, char** args)
 
         if (message == "/quit")
             break;
+
+        if (message == "/stats")
+        {
+            for (int i = 0; i < server_count; ++i)
+            {
+                const auto stats = servers[i]->get_receive_stats();
+                std::cout << std::format(
+                                 "[{}] Passes: {}, drained last: {}, max: {}, total: {}, budget exhausted: {}",
+                                 port + i, stats.passes, stats.last_pass_drained, stats.max_pass_drained,
+                                 stats.total_drained, stats.budget_exhausted_passes)
+                          << std::endl;
+                std::cout << std::format("[{}] Chats relayed without parsing: {}", port + i, stats.relayed_raw_chats)
+                          << std::endl;
+#ifdef CHAT_COUNT_ALLOCATIONS
+                std::cout << std::format("[{}] Allocations per message: {:.2f}", port + i,
+                                         stats.total_drained
+                                             ? (double)stats.message_allocations / (double)stats.total_drained
+                                             : 0.0)
+                          << std::endl;
+#endif
+
+                const auto bp_stats = servers[i]->get_backpressure_stats();
+                std::cout << std::format(
+                                 "[{}] Healthy clients: {}, slow: {}, disconnected as slow: {}, dropped chats: {}",
+                                 port + i, bp_stats.healthy_clients, bp_stats.slow_clients,
+                                 bp_stats.disconnected_clients, bp_stats.dropped_chats)
+                          << std::endl;
+            }
+
+            for (int i = 0; i < server_count; ++i)
+            {
+                const auto rl_stats = servers[i]->get_rate_limit_stats();
+                using type = st_chat_server::rate_limited_type;
+                std::cout << std::format("[{}] Rate limited chat: {} ({} bytes), name change: {} ({} bytes), "
+                                         "room: {} ({} bytes), unknown type: {}",
+                                         port + i, rl_stats.dropped_messages[(std::size_t)type::chat],
+                                         rl_stats.dropped_bytes[(std::size_t)type::chat],
+                                         rl_stats.dropped_messages[(std::size_t)type::name_change],
+                                         rl_stats.dropped_bytes[(std::size_t)type::name_change],
+                                         rl_stats.dropped_messages[(std::size_t)type::room],
+                                         rl_stats.dropped_bytes[(std::size_t)type::room],
+                                         rl_stats.unknown_type_messages)
+                          << std::endl;
+            }
+
+            for (int i = 0; i < server_count; ++i)
+                print_transport_quality(*servers[i], (std::uint16_t)(port + i));
+
+            const auto log_stats = logger::shared().get_stats();
+            std::cout << std::format("Log records written: {}, dropped: {}", log_stats.written, log_stats.dropped)
+                      << std::endl;
+
+            const auto pool_stats = buffer_pool::shared().get_stats();
+            std::cout << std::format("Buffer pool hits: {}, misses: {}, oversized: {}, in use: {}, high-water: {}",
+                                     pool_stats.hits, pool_stats.misses, pool_stats.oversized, pool_stats.in_use,
+                                     pool_stats.high_water)
+                      << std::endl;
+
+            std::cout << collect_metrics(servers, port) << std::flush;
+        }
     }
 
     // Let's quit the server now!
+    dumper.reset();
 
-    // Stop the server
-    server.stop(500);
+    // Stop the servers, giving each up to 2 seconds to flush what's queued to its clients
+    for (auto& server : servers)
+        server->stop(2000);
 
     std::cout << "Server closed!" << std::endl;
 }
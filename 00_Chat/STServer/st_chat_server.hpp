@@ -0,0 +1,1753 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "../Proto/ChatProtocol.pb.h"
+
+#include "allocation_counter.hpp"
+#include "client_registry.hpp"
+#include "connection_linger.hpp"
+#include "logger.hpp"
+#include "metrics.hpp"
+#include "shared_payload.hpp"
+#include "token_bucket.hpp"
+#include "traffic_capture.hpp"
+#include "transport.hpp"
+#include "transport_quality.hpp"
+#include "wire_format.hpp"
+
+#include <google/protobuf/arena.h>
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class st_chat_server
+{
+public:
+    static constexpr std::uint16_t DEFAULT_SERVER_PORT = 45700;
+    static constexpr int DEFAULT_MAX_MESSAGES_PER_RECEIVE = 100;
+    static constexpr std::chrono::microseconds DEFAULT_DRAIN_BUDGET{5000};
+
+    static constexpr std::size_t MAX_ROOM_NAME_LENGTH = 64;
+    static constexpr std::size_t MAX_ROOMS_PER_CLIENT = 16;
+
+    /// @brief A recipient's batch is sent right away when it grows over this, without waiting for the batch delay.
+    static constexpr std::size_t MAX_BATCH_BYTES = 32 * 1024;
+
+    /// @brief Initial block of the protobuf arena, which is kept across the resets.
+    /// The messages of a whole server loop pass should fit in this, or the arena allocates more blocks.
+    static constexpr std::size_t ARENA_INITIAL_BLOCK_SIZE = 256 * 1024;
+
+    /// @brief Upper bound of a single blocking wait on the sockets.
+    /// The server loop wakes up as soon as something arrives, so this only matters when idle,
+    /// and bounds how long `stop()` waits for the server loop to notice the quit request.
+    static constexpr int MAX_POLL_WAIT_MILLISECONDS = 100;
+
+    /// @brief What to do with a client whose connection can't keep up with what we send.
+    enum class slow_consumer_policy
+    {
+        /// @brief Stop sending chats to it until it catches up.
+        drop,
+        /// @brief Stop sending chats to it until it catches up, and then tell it how many were dropped.
+        summarize,
+        /// @brief Disconnect it right away.
+        disconnect,
+    };
+
+    /// @brief Lanes of every connection.
+    /// Each lane has its own send queue, so a long run of chats doesn't hold up the control messages.
+    /// Note that the messages are ordered only within a lane.
+    enum class lane : std::uint16_t
+    {
+        /// @brief Responses & notices from the server, e.g. the acknowledgement of a name change.
+        control,
+        chat,
+        /// @brief Large chats & batches, so that they don't hold up the small chats.
+        bulk,
+
+        count
+    };
+
+    static constexpr std::size_t LANE_COUNT = (std::size_t)lane::count;
+
+    /// @brief See `ISteamNetworkingSockets::ConfigureConnectionLanes()`.
+    struct lane_config
+    {
+        /// @brief Lower value is higher priority.
+        /// A lane is sent from only when all the lanes of higher priority are empty.
+        int priority;
+        /// @brief Share of the bandwidth among the lanes of the same priority.
+        std::uint16_t weight;
+    };
+
+    /// @brief Message types with their own rate limits.
+    enum class rate_limited_type
+    {
+        chat,
+        name_change,
+        /// @brief Join or leave a room.
+        room,
+
+        count
+    };
+
+    static constexpr std::size_t RATE_LIMITED_TYPE_COUNT = (std::size_t)rate_limited_type::count;
+
+    /// @brief Rate limit of a message type, per client.
+    struct rate_limit
+    {
+        /// @brief Zero disables the limit.
+        double messages_per_second = 0;
+        /// @brief Zero disables the limit.
+        double bytes_per_second = 0;
+        /// @brief How many seconds worth of messages & bytes a client can save up for a burst.
+        /// The byte burst is at least `k_cbMaxSteamNetworkingSocketsMessageSizeSend` regardless,
+        /// so that any single message can pass when the client hasn't sent anything for a while.
+        double burst_seconds = 2;
+    };
+
+    /// @brief Runtime settings of the server.
+    struct settings
+    {
+        /// @brief Max number of messages pulled by a single `ReceiveMessagesOnPollGroup()` call.
+        int max_messages_per_receive = DEFAULT_MAX_MESSAGES_PER_RECEIVE;
+
+        /// @brief Whether to keep receiving until the poll group is empty (or the budget is spent),
+        /// instead of receiving only once per server loop pass.
+        bool drain_until_empty = true;
+
+        /// @brief Time budget of draining the poll group in a single server loop pass.
+        /// When it's spent, the rest of the backlog is handled on the next pass without waiting on the sockets.
+        std::chrono::microseconds drain_budget = DEFAULT_DRAIN_BUDGET;
+
+        /// @brief Max delay of a chat held for coalescing, before it's sent to a recipient within a `ChatBatch`.
+        /// All the chats to a recipient within this delay are sent as a single message.
+        /// Zero disables the batching, which sends every chat right away as its own message.
+        std::chrono::microseconds batch_delay{0};
+
+        /// @brief Whether to allocate the protobuf messages from an arena reset on every server loop pass,
+        /// instead of from the heap.
+        bool use_protobuf_arena = true;
+
+        /// @brief What to do with a client whose connection can't keep up with what we send.
+        slow_consumer_policy slow_consumer = slow_consumer_policy::drop;
+
+        /// @brief A client is a slow consumer if it has more reliable bytes than this waiting to be sent,
+        std::int32_t slow_consumer_pending_bytes = 256 * 1024;
+
+        /// @brief ...or if a message queued now would wait longer than this before being sent.
+        /// It recovers when both of these go below the half of the thresholds.
+        std::chrono::milliseconds slow_consumer_queue_time{1000};
+
+        /// @brief How often the send queues of all the clients are checked.
+        std::chrono::milliseconds slow_consumer_check_interval{100};
+
+        /// @brief Time to sample the transport status of all the connections once, for `get_transport_quality()`.
+        /// The sampling is spread over the server loop passes within this, instead of done all at once.
+        /// Zero disables the sampling.
+        std::chrono::milliseconds transport_sample_interval{5000};
+
+        /// @brief Rate limits of each message type, per client.
+        /// Messages over the limit are dropped before they're parsed.
+        /// Disable them to load test or replay a capture, which would be mostly dropped otherwise.
+        rate_limit chat_rate_limit{.messages_per_second = 10, .bytes_per_second = 16 * 1024, .burst_seconds = 2};
+        rate_limit name_change_rate_limit{.messages_per_second = 1, .bytes_per_second = 1024, .burst_seconds = 5};
+        rate_limit room_rate_limit{.messages_per_second = 2, .bytes_per_second = 1024, .burst_seconds = 5};
+
+        /// @brief Priority & weight of each `lane`.
+        std::array<lane_config, LANE_COUNT> lanes{{
+            {.priority = 0, .weight = 1},
+            {.priority = 1, .weight = 3},
+            {.priority = 1, .weight = 1},
+        }};
+
+        /// @brief Chats & batches of at least this many bytes are sent on `lane::bulk` instead of `lane::chat`.
+        std::uint32_t bulk_lane_min_bytes = 4 * 1024;
+
+        /// @brief File to capture the traffic from the clients into, to replay it later with `chat_replay`.
+        /// Empty disables the capture.
+        std::string capture_path;
+
+        /// @brief Whether the caller runs the server loop passes with `poll()`, instead of the server's own thread.
+        /// This lets a benchmark step the server deterministically on its thread.
+        bool manual_poll = false;
+    };
+
+    /// @brief Metrics of a server, updated by the server loop and readable from any thread.
+    struct server_metrics
+    {
+        counter messages_in;
+        counter bytes_in;
+        counter messages_out;
+        counter bytes_out;
+        counter connects;
+        counter disconnects;
+
+        gauge connected_clients;
+        /// @brief Clients that have set their names.
+        gauge logged_in_clients;
+
+        /// @brief Time spent on a server loop pass, excluding the wait on the sockets, in microseconds.
+        histogram tick_duration_us;
+        /// @brief Time from a chat arriving on the socket until it's handed to GNS for the recipients,
+        /// in microseconds. This includes the time it's held for the batching.
+        histogram receive_to_send_latency_us;
+
+        void reset()
+        {
+            for (counter* c : {&messages_in, &bytes_in, &messages_out, &bytes_out, &connects, &disconnects})
+                c->reset();
+            connected_clients.reset();
+            logged_in_clients.reset();
+            tick_duration_us.reset();
+            receive_to_send_latency_us.reset();
+        }
+    };
+
+    /// @brief Statistics on the messages dropped before being parsed.
+    struct rate_limit_stats
+    {
+        /// @brief Messages dropped for going over the rate limit, per `rate_limited_type`.
+        std::array<std::uint64_t, RATE_LIMITED_TYPE_COUNT> dropped_messages;
+        std::array<std::uint64_t, RATE_LIMITED_TYPE_COUNT> dropped_bytes;
+        /// @brief Messages dropped for not being any of the known message types.
+        std::uint64_t unknown_type_messages;
+    };
+
+    /// @brief Statistics on the slow consumers.
+    struct backpressure_stats
+    {
+        /// @brief Clients currently keeping up with what we send.
+        std::uint64_t healthy_clients;
+        /// @brief Clients currently not receiving chats, because they can't keep up.
+        std::uint64_t slow_clients;
+        /// @brief Clients disconnected so far, because they couldn't keep up.
+        std::uint64_t disconnected_clients;
+        /// @brief Chats not sent so far, because the recipient couldn't keep up.
+        std::uint64_t dropped_chats;
+    };
+
+    /// @brief Statistics on how many messages each server loop pass drained.
+    struct receive_stats
+    {
+        std::uint64_t passes;
+        std::uint64_t last_pass_drained;
+        std::uint64_t max_pass_drained;
+        std::uint64_t total_drained;
+
+        /// @brief Number of passes that spent the whole drain budget, i.e. the server was falling behind.
+        std::uint64_t budget_exhausted_passes;
+
+        /// @brief Chats relayed on the fast path, without parsing them.
+        std::uint64_t relayed_raw_chats;
+
+        /// @brief Heap allocations made while handling the messages, including the responses to them.
+        /// Divide this by `total_drained` to get the allocations per message.
+        /// Zero unless the executable counts them, see `t_allocation_count`.
+        std::uint64_t message_allocations;
+    };
+
+public:
+    struct message_rate_limiter
+    {
+        token_bucket messages;
+        token_bucket bytes;
+    };
+
+    /// @brief State of a connected client, public for the benchmarks of `registry_type`.
+    struct client_info
+    {
+        std::string name;
+
+        // `name`, or "Guest#<connection>" if it's not set.
+        std::string display_name;
+        // `display_name` encoded as a `Chat.sender_name` field, spliced as is into every chat from this client.
+        std::vector<std::byte> encoded_sender_name;
+
+        // Rate limiters of each `rate_limited_type`.
+        std::array<message_rate_limiter, RATE_LIMITED_TYPE_COUNT> rate_limiters;
+
+        // Rooms this client has joined.
+        std::vector<std::string> rooms;
+
+        // Encoded `ChatBatch.chats` entries waiting to be sent to this client, when batching is enabled.
+        std::vector<std::byte> pending_batch;
+        // Whether this client is in `_batch_recipients`, which an early send of its batch doesn't change.
+        bool in_batch_recipients = false;
+
+        // Chats dropped since this client became a slow consumer.
+        std::uint64_t dropped_chats = 0;
+    };
+
+    /// @brief State of a connected client read by every broadcast, packed apart from its `client_info`.
+    struct client_hot_info
+    {
+        // Whether this client can't keep up with what we send, so chats to it are dropped.
+        bool slow = false;
+    };
+
+    using registry_type = client_registry<client_info, client_hot_info>;
+    using client_handle = registry_type::handle;
+
+private:
+    // Lets a map keyed by `std::string` be looked up with a `std::string_view`, without making a string.
+    struct string_hash
+    {
+        using is_transparent = void;
+
+        auto operator()(std::string_view str) const -> std::size_t
+        {
+            return std::hash<std::string_view>{}(str);
+        }
+    };
+
+    /// @brief Fields of a `ChatProtocol.chat`, pointing into the received message.
+    struct chat_view
+    {
+        std::string_view content;
+        std::string_view room;
+    };
+
+    struct room_info
+    {
+        // Members of this room, so that a chat to this room only touches them.
+        std::vector<client_handle> members;
+    };
+
+private:
+    // Servers by their listen sockets, to route the connection status changed callbacks to the owner.
+    inline static std::mutex _servers_mutex;
+    inline static std::unordered_map<HSteamListenSocket, st_chat_server*> _servers;
+
+    bool _disposed = true;
+
+    // Sockets the server runs on; the GNS, unless a benchmark puts a fake in.
+    transport& _transport;
+    bool _transport_acquired = false;
+
+    settings _settings;
+    std::vector<SteamNetworkingMessage_t*> _received_msgs;
+
+    HSteamNetPollGroup _poll_group = k_HSteamNetPollGroup_Invalid;
+    HSteamListenSocket _listen_socket = k_HSteamListenSocket_Invalid;
+
+    registry_type _clients;
+    std::unordered_map<std::string, room_info, string_hash, std::equal_to<>> _rooms;
+
+    // Reused for every broadcast, to submit all the messages with a single `SendMessages()` call.
+    std::vector<SteamNetworkingMessage_t*> _outgoing_msgs;
+
+    // Clients with a pending batch, and when the oldest chat in those batches should be sent.
+    std::vector<client_handle> _batch_recipients;
+    std::chrono::steady_clock::time_point _batch_deadline;
+    std::vector<std::byte> _batch_entry;
+
+    std::chrono::steady_clock::time_point _next_slow_consumer_check;
+    std::vector<client_handle> _slow_consumers_to_disconnect;
+
+    // Transport status sampled so far, and where the current sweep over `_clients` is.
+    // As a removal moves the last client into the hole, a client might be missed or sampled twice in a sweep.
+    transport_quality _transport_quality;
+    std::size_t _transport_sample_cursor = 0;
+    std::chrono::steady_clock::time_point _transport_sweep_start;
+
+    // Written by the server loop, read by anyone via `get_backpressure_stats()`.
+    std::atomic<std::uint64_t> _slow_clients;
+    std::atomic<std::uint64_t> _disconnected_slow_clients;
+    std::atomic<std::uint64_t> _dropped_chats;
+
+    server_metrics _metrics;
+
+    // Receive times of the chats waiting in the batches, to measure their latency when the batches are sent.
+    std::vector<SteamNetworkingMicroseconds> _batched_chat_receive_times;
+
+    // Traffic from the clients is written here, if `settings::capture_path` is set.
+    traffic_capture::writer _capture;
+    bool _capturing = false;
+
+    // Written by the server loop, read by anyone via `get_rate_limit_stats()`.
+    std::array<std::atomic<std::uint64_t>, RATE_LIMITED_TYPE_COUNT> _rate_limited_messages;
+    std::array<std::atomic<std::uint64_t>, RATE_LIMITED_TYPE_COUNT> _rate_limited_bytes;
+    std::atomic<std::uint64_t> _unknown_type_messages;
+
+    // Connection status changes routed to this server, handled on the server loop.
+    std::mutex _status_changes_mutex;
+    std::vector<SteamNetConnectionStatusChangedCallback_t> _status_changes;
+    std::vector<SteamNetConnectionStatusChangedCallback_t> _handling_status_changes;
+
+    std::atomic<bool> _quit_requested;
+    std::thread _server_thread;
+    std::uint64_t _seen_wake_seq = 0;
+
+    // Whether the last pass couldn't drain everything within its budget.
+    bool _falling_behind = false;
+
+    // Written by the server loop, read by anyone via `get_receive_stats()`.
+    std::atomic<std::uint64_t> _passes;
+    std::atomic<std::uint64_t> _last_pass_drained;
+    std::atomic<std::uint64_t> _max_pass_drained;
+    std::atomic<std::uint64_t> _total_drained;
+    std::atomic<std::uint64_t> _budget_exhausted_passes;
+    std::atomic<std::uint64_t> _relayed_raw_chats;
+    std::atomic<std::uint64_t> _message_allocations;
+
+    // Protobuf messages of a server loop pass are allocated here, and freed all at once at the end of the pass.
+    std::unique_ptr<char[]> _arena_initial_block = std::make_unique<char[]>(ARENA_INITIAL_BLOCK_SIZE);
+    google::protobuf::Arena _arena{_arena_initial_block.get(), ARENA_INITIAL_BLOCK_SIZE};
+
+public:
+    st_chat_server() : st_chat_server(gns_transport::shared())
+    {
+    }
+
+    /// @brief Make a server on the transport, e.g. `memory_transport` to benchmark it without sockets.
+    explicit st_chat_server(transport& server_transport) : _transport(server_transport)
+    {
+    }
+
+    // Callbacks are routed to this server by its address
+    st_chat_server(const st_chat_server&) = delete;
+    st_chat_server& operator=(const st_chat_server&) = delete;
+
+    ~st_chat_server()
+    {
+        dispose();
+    }
+
+public:
+    /// @brief Start the server with specified port, with default settings.
+    /// @param port Port to listen.
+    /// @return Whether the server has been started to run, or errored.
+    bool start(std::uint16_t port)
+    {
+        return start(port, settings{});
+    }
+
+    /// @brief Start the server with specified port and settings.
+    /// @param port Port to listen.
+    /// @param server_settings Runtime settings of the server.
+    /// @return Whether the server has been started to run, or errored.
+    bool start(std::uint16_t port, const settings& server_settings)
+    {
+        if (server_settings.max_messages_per_receive <= 0)
+        {
+            logger::error("Failed to start st_chat_server: invalid max_messages_per_receive {}",
+                          server_settings.max_messages_per_receive);
+            return false;
+        }
+
+        _disposed = false;
+
+        try
+        {
+            _settings = server_settings;
+            _received_msgs.resize(_settings.max_messages_per_receive);
+
+            _passes.store(0, std::memory_order_relaxed);
+            _last_pass_drained.store(0, std::memory_order_relaxed);
+            _max_pass_drained.store(0, std::memory_order_relaxed);
+            _total_drained.store(0, std::memory_order_relaxed);
+            _budget_exhausted_passes.store(0, std::memory_order_relaxed);
+            _relayed_raw_chats.store(0, std::memory_order_relaxed);
+            _message_allocations.store(0, std::memory_order_relaxed);
+            _slow_clients.store(0, std::memory_order_relaxed);
+            _disconnected_slow_clients.store(0, std::memory_order_relaxed);
+            _dropped_chats.store(0, std::memory_order_relaxed);
+            _metrics.reset();
+            _transport_quality.reset();
+            _transport_sample_cursor = 0;
+            _transport_sweep_start = std::chrono::steady_clock::now();
+            for (auto& counter : _rate_limited_messages)
+                counter.store(0, std::memory_order_relaxed);
+            for (auto& counter : _rate_limited_bytes)
+                counter.store(0, std::memory_order_relaxed);
+            _unknown_type_messages.store(0, std::memory_order_relaxed);
+
+            // Initialize `GameNetworkingSockets`, or share it with other servers in this process
+            _transport.acquire();
+            _transport_acquired = true;
+
+            // Prepare poll group
+            _poll_group = _transport.create_poll_group();
+
+            // Capture the traffic from the clients, if asked
+            if (!_settings.capture_path.empty())
+            {
+                _capture.open(_settings.capture_path, _transport.local_timestamp());
+                _capturing = true;
+            }
+
+            // Manage connected clients' info with a slot map, which packs them for the broadcasts.
+            // Note that a client might not logged in yet.
+            _clients.clear();
+
+            // Setup configuration used for listen socket
+            SteamNetworkingConfigValue_t configs[1]{};
+            configs[0].SetPtr(k_ESteamNetworkingConfig_Callback_ConnectionStatusChanged,
+                              (void*)dispatch_connection_status_changed);
+
+            {
+                // Callbacks can't run while we hold this,
+                // so no callback sees the listen socket before it's registered.
+                const auto polling_lock = _transport.lock_polling();
+
+                // Start listening
+                SteamNetworkingIPAddr addr{};
+                addr.m_port = port;
+                _listen_socket = _transport.create_listen_socket_ip(addr, 1, configs);
+                if (_listen_socket == k_HSteamListenSocket_Invalid)
+                {
+                    throw std::runtime_error("Failed to create a listen socket");
+                }
+
+                // Route the callbacks of the connections accepted from it to this server
+                std::lock_guard servers_lock(_servers_mutex);
+                _servers[_listen_socket] = this;
+            }
+
+            // Create the server loop as a seperate thread, unless the caller polls by itself
+            _quit_requested.store(false, std::memory_order_relaxed);
+            _falling_behind = false;
+            if (!_settings.manual_poll)
+                _server_thread = std::thread(&st_chat_server::server_loop, this);
+        }
+        catch (const std::exception& ex)
+        {
+            logger::error("Failed to start st_chat_server: {}", ex.what());
+
+            dispose();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Stop the server.
+    /// @param linger_milliseconds Max milliseconds to wait for the connections to send what's queued to them,
+    /// e.g. a goodbye message, before dropping them. It returns as soon as they all have.
+    /// @return Number of connections that still had something to send when the wait was given up.
+    auto stop(int linger_milliseconds = 0) -> std::size_t
+    {
+        if (_disposed)
+            return 0;
+
+        logger::info("Stopping the server loop...");
+
+        // Stop the server loop, so that nothing more is queued to the connections
+        _quit_requested.store(true, std::memory_order_relaxed);
+        _transport.wake();
+        if (_server_thread.joinable())
+            _server_thread.join();
+
+        logger::info("Closing connections...");
+
+        std::vector<HSteamNetConnection> conns(_clients.connections().begin(), _clients.connections().end());
+        const std::size_t unflushed =
+            connection_linger::close_when_flushed(_transport, _seen_wake_seq, std::move(conns), linger_milliseconds);
+
+        // This should be AFTER lingering, because closing listen socket drops all connections accepted from it
+        dispose();
+
+        return unflushed;
+    }
+
+    /// @brief Disposes the server synchronously.
+    /// If it was not stopped, it will block to stop.
+    void dispose()
+    {
+        if (!_disposed)
+        {
+            _quit_requested.store(true, std::memory_order_relaxed);
+            _transport.wake();
+            if (_server_thread.joinable())
+                _server_thread.join();
+
+            if (_listen_socket != k_HSteamListenSocket_Invalid)
+            {
+                {
+                    std::lock_guard servers_lock(_servers_mutex);
+                    _servers.erase(_listen_socket);
+                }
+
+                _transport.close_listen_socket(_listen_socket);
+                _listen_socket = k_HSteamListenSocket_Invalid;
+            }
+
+            // The clients left are disconnected by the server, so the capture ends with them too
+            if (_capturing)
+            {
+                const SteamNetworkingMicroseconds now = _transport.local_timestamp();
+                for (const auto conn : _clients.connections())
+                    _capture.add_disconnect(conn, now);
+            }
+
+            _clients.clear();
+            _rooms.clear();
+            _batch_recipients.clear();
+            _batched_chat_receive_times.clear();
+
+            if (_capturing)
+            {
+                _capture.close();
+                _capturing = false;
+
+                const auto capture_stats = _capture.get_stats();
+                logger::info("Captured {} records to {}, {} dropped", capture_stats.records, _settings.capture_path,
+                             capture_stats.dropped_records);
+            }
+
+            {
+                std::lock_guard status_changes_lock(_status_changes_mutex);
+                _status_changes.clear();
+            }
+
+            if (_poll_group != k_HSteamNetPollGroup_Invalid)
+            {
+                _transport.destroy_poll_group(_poll_group);
+                _poll_group = k_HSteamNetPollGroup_Invalid;
+            }
+
+            if (_transport_acquired)
+            {
+                _transport.release();
+                _transport_acquired = false;
+            }
+
+            _disposed = true;
+        }
+    }
+
+    /// @brief Run a single server loop pass on the calling thread.
+    /// Only for a server started with `settings::manual_poll`, which has no server loop thread of its own.
+    /// @param max_wait_milliseconds Max time to wait on the sockets, if there's nothing to handle yet.
+    void poll(int max_wait_milliseconds = 0)
+    {
+        if (_disposed || !_settings.manual_poll)
+            return;
+
+        run_pass(max_wait_milliseconds);
+    }
+
+    /// @brief Get the statistics on how many messages each server loop pass drained.
+    /// This can be called from any thread.
+    auto get_receive_stats() const -> receive_stats
+    {
+        return receive_stats{
+            .passes = _passes.load(std::memory_order_relaxed),
+            .last_pass_drained = _last_pass_drained.load(std::memory_order_relaxed),
+            .max_pass_drained = _max_pass_drained.load(std::memory_order_relaxed),
+            .total_drained = _total_drained.load(std::memory_order_relaxed),
+            .budget_exhausted_passes = _budget_exhausted_passes.load(std::memory_order_relaxed),
+            .relayed_raw_chats = _relayed_raw_chats.load(std::memory_order_relaxed),
+            .message_allocations = _message_allocations.load(std::memory_order_relaxed),
+        };
+    }
+
+    /// @brief Get the statistics on the slow consumers.
+    /// This can be called from any thread.
+    auto get_backpressure_stats() const -> backpressure_stats
+    {
+        // `_clients` is not safe to read from here, so use the client count mirrored by the server loop
+        const std::uint64_t slow_clients = _slow_clients.load(std::memory_order_relaxed);
+        const auto all_clients = (std::uint64_t)_metrics.connected_clients.value();
+
+        return backpressure_stats{
+            .healthy_clients = all_clients - std::min(all_clients, slow_clients),
+            .slow_clients = slow_clients,
+            .disconnected_clients = _disconnected_slow_clients.load(std::memory_order_relaxed),
+            .dropped_chats = _dropped_chats.load(std::memory_order_relaxed),
+        };
+    }
+
+    /// @brief Get the metrics of this server.
+    /// This can be called from any thread.
+    auto get_metrics() const -> const server_metrics&
+    {
+        return _metrics;
+    }
+
+    /// @brief Write the metrics of this server in the text format.
+    /// This can be called from any thread.
+    /// @param text Text to append to.
+    /// @param labels Labels to put on every sample, e.g. `server="45700"`.
+    void write_metrics(metrics_text& text, std::string_view labels) const
+    {
+        text.add("chat_messages_in_total", labels, _metrics.messages_in.value());
+        text.add("chat_bytes_in_total", labels, _metrics.bytes_in.value());
+        text.add("chat_messages_out_total", labels, _metrics.messages_out.value());
+        text.add("chat_bytes_out_total", labels, _metrics.bytes_out.value());
+        text.add("chat_connects_total", labels, _metrics.connects.value());
+        text.add("chat_disconnects_total", labels, _metrics.disconnects.value());
+        text.add("chat_connected_clients", labels, _metrics.connected_clients.value());
+        text.add("chat_logged_in_clients", labels, _metrics.logged_in_clients.value());
+        text.add("chat_tick_duration_us", labels, _metrics.tick_duration_us.get_summary());
+        text.add("chat_receive_to_send_latency_us", labels, _metrics.receive_to_send_latency_us.get_summary());
+
+        const auto transport = _transport_quality.get_report();
+        text.add("chat_transport_ping_ms", labels, transport.ping_ms);
+        text.add("chat_transport_local_loss_per_mille", labels, transport.local_loss_per_mille);
+        text.add("chat_transport_remote_loss_per_mille", labels, transport.remote_loss_per_mille);
+        text.add("chat_transport_send_rate_bytes", labels, transport.send_rate_bytes);
+        text.add("chat_transport_pending_reliable_bytes", labels, transport.pending_reliable_bytes);
+        text.add("chat_transport_pending_unreliable_bytes", labels, transport.pending_unreliable_bytes);
+        text.add("chat_transport_queue_time_us", labels, transport.queue_time_us);
+        text.add("chat_transport_outliers", labels, (std::uint64_t)transport.outliers.size());
+
+        if (!_settings.capture_path.empty())
+        {
+            const auto capture = _capture.get_stats();
+            text.add("chat_capture_records_total", labels, capture.records);
+            text.add("chat_capture_bytes_total", labels, capture.bytes_written);
+            text.add("chat_capture_dropped_records_total", labels, capture.dropped_records);
+        }
+    }
+
+    /// @brief Get the summaries of the transport status of all the connections, sampled over the last sweep.
+    /// This can be called from any thread.
+    auto get_transport_quality() const -> transport_quality::report
+    {
+        return _transport_quality.get_report();
+    }
+
+    /// @brief Get the statistics on the messages dropped before being parsed.
+    /// This can be called from any thread.
+    auto get_rate_limit_stats() const -> rate_limit_stats
+    {
+        rate_limit_stats stats{};
+        for (std::size_t i = 0; i < RATE_LIMITED_TYPE_COUNT; ++i)
+        {
+            stats.dropped_messages[i] = _rate_limited_messages[i].load(std::memory_order_relaxed);
+            stats.dropped_bytes[i] = _rate_limited_bytes[i].load(std::memory_order_relaxed);
+        }
+        stats.unknown_type_messages = _unknown_type_messages.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    /// @brief Receive data and run callbacks here.
+    void server_loop()
+    {
+        while (!_quit_requested.load(std::memory_order_relaxed))
+            run_pass(MAX_POLL_WAIT_MILLISECONDS);
+    }
+
+    /// @brief Wait on the sockets for up to `max_wait_milliseconds`, and handle whatever arrived.
+    void run_pass(int max_wait_milliseconds)
+    {
+        const bool was_falling_behind = _falling_behind;
+
+        // Block until the sockets have something for us, or a GNS timer is due.
+        // This returns right away when packets arrive, so there's no fixed delay added to each relay,
+        // and it barely costs anything while idle.
+        //
+        // If the last pass couldn't drain everything within its budget, don't wait at all.
+        // If there are pending batches, don't wait past their deadline.
+        int wait_milliseconds = _falling_behind ? 0 : max_wait_milliseconds;
+        if (!_batch_recipients.empty())
+        {
+            const auto until_deadline = std::chrono::ceil<std::chrono::milliseconds>(
+                _batch_deadline - std::chrono::steady_clock::now());
+            wait_milliseconds = (int)std::clamp<long long>(until_deadline.count(), 0, wait_milliseconds);
+        }
+        _transport.wait(_seen_wake_seq, wait_milliseconds);
+        const auto tick_start = std::chrono::steady_clock::now();
+
+        handle_status_changes();
+
+        const std::uint64_t drained = receive_messages(_falling_behind);
+
+        // Send the pending batches, if it's time
+        const auto now = std::chrono::steady_clock::now();
+        if (!_batch_recipients.empty() && now >= _batch_deadline)
+            flush_batches();
+
+        // Check the send queues of the clients, if it's time
+        if (now >= _next_slow_consumer_check)
+        {
+            check_slow_consumers();
+            _next_slow_consumer_check = now + _settings.slow_consumer_check_interval;
+        }
+
+        sample_transport_quality(now);
+
+        if (_capturing)
+            _capture.flush();
+
+        // Free all the protobuf messages of this pass at once, keeping the initial block for the next pass
+        _arena.Reset();
+
+        _metrics.tick_duration_us.record((std::uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(
+                                             std::chrono::steady_clock::now() - tick_start)
+                                             .count());
+
+        // Report how much this pass drained
+        _passes.fetch_add(1, std::memory_order_relaxed);
+        _last_pass_drained.store(drained, std::memory_order_relaxed);
+        _total_drained.fetch_add(drained, std::memory_order_relaxed);
+        if (drained > _max_pass_drained.load(std::memory_order_relaxed))
+            _max_pass_drained.store(drained, std::memory_order_relaxed);
+        if (_falling_behind)
+            _budget_exhausted_passes.fetch_add(1, std::memory_order_relaxed);
+
+        if (_falling_behind && !was_falling_behind)
+            logger::warning("Server loop is falling behind: drained {} messages, but some are left", drained);
+        else if (!_falling_behind && was_falling_behind)
+            logger::info("Server loop caught up");
+    }
+
+    /// @brief Receive messages on the poll group, and handle them.
+    /// @param budget_exhausted Set to whether the drain budget was spent before the poll group got empty.
+    /// @return Number of messages drained in this pass.
+    auto receive_messages(bool& budget_exhausted) -> std::uint64_t
+    {
+        const auto pass_start = std::chrono::steady_clock::now();
+        const int batch_size = _settings.max_messages_per_receive;
+
+        std::uint64_t drained = 0;
+        budget_exhausted = false;
+
+        while (true)
+        {
+            int received_msg_count =
+                _transport.receive_messages_on_poll_group(_poll_group, _received_msgs.data(), batch_size);
+            if (received_msg_count == -1)
+            {
+                throw std::runtime_error("receive msg failed");
+            }
+
+            const std::uint64_t allocations_before = t_allocation_count;
+            for (int i = 0; i < received_msg_count; ++i)
+            {
+                _metrics.bytes_in.add((std::uint64_t)_received_msgs[i]->m_cbSize);
+                if (_capturing)
+                {
+                    const auto& msg = *_received_msgs[i];
+                    _capture.add_message(msg.m_conn, msg.m_usecTimeReceived, msg.m_pData, msg.m_cbSize);
+                }
+                on_message(*_received_msgs[i]);
+
+                _received_msgs[i]->Release();
+            }
+            _message_allocations.fetch_add(t_allocation_count - allocations_before, std::memory_order_relaxed);
+            _metrics.messages_in.add((std::uint64_t)received_msg_count);
+            drained += received_msg_count;
+
+            // Received less than we asked for, which means the poll group is empty now.
+            // (If something new arrives in the middle, the next `transport::wait()` returns right away.)
+            if (!_settings.drain_until_empty || received_msg_count < batch_size)
+                break;
+
+            if (std::chrono::steady_clock::now() - pass_start >= _settings.drain_budget)
+            {
+                budget_exhausted = true;
+                break;
+            }
+        }
+
+        return drained;
+    }
+
+    /// @brief Callback that's called from the GNS when connection status changed for any client of any server.
+    /// This function is static, due to GNS's callbacks using function pointers,
+    /// so it routes the callback to the server owning the listen socket the connection was accepted from.
+    ///
+    /// It's called on whichever thread is polling the sockets in `transport::wait()`,
+    /// which might not be the server loop of the owner, so the owner handles it later on its own server loop.
+    /// @param info Connection status changed info.
+    static void dispatch_connection_status_changed(SteamNetConnectionStatusChangedCallback_t* info)
+    {
+        std::unique_lock servers_lock(_servers_mutex);
+
+        auto it = _servers.find(info->m_info.m_hListenSocket);
+        if (it == _servers.end())
+        {
+            servers_lock.unlock();
+
+            // The owner is already gone, so just clean up the connection.
+            // Only the GNS gets here, as `memory_transport` drops the callbacks of a closed listen socket.
+            if (info->m_info.m_eState != k_ESteamNetworkingConnectionState_None)
+                gns_transport::shared().close_connection(info->m_hConn, 0, "Server shutdown", false);
+            return;
+        }
+
+        st_chat_server& server = *it->second;
+        std::lock_guard status_changes_lock(server._status_changes_mutex);
+        server._status_changes.push_back(*info);
+    }
+
+    /// @brief Handle the connection status changes routed to this server.
+    void handle_status_changes()
+    {
+        {
+            std::lock_guard status_changes_lock(_status_changes_mutex);
+            _handling_status_changes.swap(_status_changes);
+        }
+
+        for (auto& info : _handling_status_changes)
+            on_connection_status_changed(info);
+        _handling_status_changes.clear();
+    }
+
+    /// @brief Called when connection status changed for a client of this server.
+    /// @param info Connection status changed info.
+    void on_connection_status_changed(SteamNetConnectionStatusChangedCallback_t& info)
+    {
+        switch (info.m_info.m_eState)
+        {
+        case k_ESteamNetworkingConnectionState_None:
+            // This is when you destroy the connection.
+            // Nothing to do here.
+            break;
+
+        case k_ESteamNetworkingConnectionState_Connecting: {
+
+            // Add new client to `clients`
+            // It doesn't have a name yet, which means it's not properly logged in.
+            //
+            // Note that we do this BEFORE accepting the connection.
+            // The handle of the client is stored in the connection user data, which GNS copies to every message
+            // received on it, so it must be there before the client can send anything.
+            const client_handle handle = _clients.insert(info.m_hConn, make_client_info(info.m_hConn));
+            _metrics.connected_clients.set((std::int64_t)_clients.size());
+            _transport.set_connection_user_data(info.m_hConn, registry_type::to_user_data(handle));
+
+            // Accept the connection.
+            // You could also close the connection right away.
+            EResult accept_result = _transport.accept_connection(info.m_hConn);
+
+            // If accept failed, clean up the connection.
+            if (accept_result != k_EResultOK)
+            {
+                remove_client(handle);
+                _transport.close_connection(info.m_hConn, 0, "Accept failure", false);
+                logger::error("Accept failed with {}", (int)accept_result);
+                break;
+            }
+
+            // Set up the lanes, so that the control messages don't wait behind the chats
+            if (!configure_lanes(info.m_hConn))
+            {
+                remove_client(handle);
+                _transport.close_connection(info.m_hConn, 0, "Lane configure failure", false);
+                logger::error("Failed to configure lanes");
+                break;
+            }
+
+            // Assign new client to the poll group
+            if (!_transport.set_connection_poll_group(info.m_hConn, _poll_group))
+            {
+                remove_client(handle);
+                _transport.close_connection(info.m_hConn, 0, "Poll group assign failure", false);
+
+                logger::error("Failed to assign poll group");
+                break;
+            }
+
+            logger::info("New client #{} connected!", info.m_hConn);
+            _metrics.connects.add();
+            if (_capturing)
+                _capture.add_connect(info.m_hConn, _transport.local_timestamp());
+
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_ClosedByPeer:
+        case k_ESteamNetworkingConnectionState_ProblemDetectedLocally: {
+            // Connection changed callbacks are dispatched in FIFO order.
+
+            // Get the client from `clients`, via the handle in the connection user data.
+            // It might have been removed already, if we've disconnected it as a slow consumer.
+            const client_handle handle = registry_type::from_user_data(info.m_info.m_nUserData);
+            const client_info* client = _clients.get(handle);
+            if (!client)
+            {
+                _transport.close_connection(info.m_hConn, 0, nullptr, false);
+                break;
+            }
+
+            if (_capturing)
+                _capture.add_disconnect(info.m_hConn, _transport.local_timestamp());
+
+            // Print the reason of connection close
+            SteamNetConnectionInfo_t& conn_info = info.m_info;
+            std::string_view client_name = "(not logged-in client)";
+            if (!client->name.empty())
+                client_name = client->name;
+            std::string_view state = conn_info.m_eState == k_ESteamNetworkingConnectionState_ClosedByPeer
+                                         ? "closed by peer"
+                                         : "problem detected locally";
+            std::string_view desc =
+                conn_info.m_szConnectionDescription ? conn_info.m_szConnectionDescription : "(Invalid desc)";
+            std::string_view dbg = conn_info.m_szEndDebug ? conn_info.m_szEndDebug : "(Invalid dbg)";
+            char addr_str[SteamNetworkingIPAddr::k_cchMaxString];
+            conn_info.m_addrRemote.ToString(addr_str, sizeof addr_str, true);
+
+            logger::info("{} ({}) {} ({}), reason {}: {}", client_name, addr_str, desc, state, conn_info.m_eEndReason,
+                         dbg);
+
+            // Remove it from the rooms it has joined, and from `clients`
+            remove_client(handle);
+            _metrics.disconnects.add();
+
+            // Don't forget to clean up the connection!
+            _transport.close_connection(info.m_hConn, 0, nullptr, false);
+
+            break;
+        }
+
+        case k_ESteamNetworkingConnectionState_Connected:
+            // Callback after accepting the connection.
+            // Nothing to do here, as we're the server.
+            break;
+        }
+    }
+
+    /// @brief Configure the lanes of the connection with the priorities & weights from the settings.
+    bool configure_lanes(HSteamNetConnection conn)
+    {
+        std::array<int, LANE_COUNT> priorities;
+        std::array<std::uint16_t, LANE_COUNT> weights;
+        for (std::size_t i = 0; i < LANE_COUNT; ++i)
+        {
+            priorities[i] = _settings.lanes[i].priority;
+            weights[i] = _settings.lanes[i].weight;
+        }
+
+        const EResult result =
+            _transport.configure_connection_lanes(conn, (int)LANE_COUNT, priorities.data(), weights.data());
+        return result == k_EResultOK;
+    }
+
+    /// @brief Lane to send a chat (or a batch of them) on, depending on its size.
+    auto chat_lane(std::uint32_t size) const -> lane
+    {
+        return size >= _settings.bulk_lane_min_bytes ? lane::bulk : lane::chat;
+    }
+
+    /// @brief Make the info of a new client, with the rate limiters configured.
+    auto make_client_info(HSteamNetConnection conn) const -> client_info
+    {
+        client_info client;
+        set_display_name(client, std::format("Guest#{}", conn));
+
+        auto configure = [&client](rate_limited_type type, const rate_limit& limit) {
+            client.rate_limiters[(std::size_t)type] = message_rate_limiter{
+                .messages = token_bucket(limit.messages_per_second, limit.messages_per_second * limit.burst_seconds),
+                .bytes = token_bucket(limit.bytes_per_second,
+                                      std::max(limit.bytes_per_second * limit.burst_seconds,
+                                               (double)k_cbMaxSteamNetworkingSocketsMessageSizeSend)),
+            };
+        };
+        configure(rate_limited_type::chat, _settings.chat_rate_limit);
+        configure(rate_limited_type::name_change, _settings.name_change_rate_limit);
+        configure(rate_limited_type::room, _settings.room_rate_limit);
+
+        return client;
+    }
+
+    /// @brief Set the display name of the client, and encode it for the chats from this client.
+    static void set_display_name(client_info& client, std::string display_name)
+    {
+        constexpr int field_number = GNSPrac::Chat::Chat::kSenderNameFieldNumber;
+
+        client.display_name = std::move(display_name);
+        client.encoded_sender_name.resize(wire_format::len_field_size(field_number, client.display_name));
+        wire_format::write_len_field(client.encoded_sender_name.data(), field_number, client.display_name);
+    }
+
+    /// @brief Size of a `Chat` from the client, encoded by `write_chat()`.
+    static auto chat_size(const client_info& client, std::string_view content, std::string_view room)
+        -> std::uint32_t
+    {
+        std::size_t size = client.encoded_sender_name.size();
+        if (!content.empty())
+            size += wire_format::len_field_size(GNSPrac::Chat::Chat::kContentFieldNumber, content);
+        if (!room.empty())
+            size += wire_format::len_field_size(GNSPrac::Chat::Chat::kRoomFieldNumber, room);
+        return (std::uint32_t)size;
+    }
+
+    /// @brief Encode a `Chat` from the client, splicing its cached `sender_name` field.
+    /// Empty fields are omitted, the same as the generated code does.
+    /// @return Pointer past the written message.
+    static auto write_chat(std::byte* out, const client_info& client, std::string_view content,
+                           std::string_view room) -> std::byte*
+    {
+        out = std::copy(client.encoded_sender_name.begin(), client.encoded_sender_name.end(), out);
+        if (!content.empty())
+            out = wire_format::write_len_field(out, GNSPrac::Chat::Chat::kContentFieldNumber, content);
+        if (!room.empty())
+            out = wire_format::write_len_field(out, GNSPrac::Chat::Chat::kRoomFieldNumber, room);
+        return out;
+    }
+
+    /// @brief Which rate limit applies to a `ChatProtocol` field.
+    /// @return `rate_limited_type::count` if it's not a message type a client can send.
+    static auto rate_limited_type_of(int field_number) -> rate_limited_type
+    {
+        using GNSPrac::Chat::ChatProtocol;
+
+        switch (field_number)
+        {
+        case ChatProtocol::kChatFieldNumber:
+            return rate_limited_type::chat;
+        case ChatProtocol::kNameChangeFieldNumber:
+            return rate_limited_type::name_change;
+        case ChatProtocol::kJoinRoomFieldNumber:
+        case ChatProtocol::kLeaveRoomFieldNumber:
+            return rate_limited_type::room;
+        default:
+            return rate_limited_type::count;
+        }
+    }
+
+    /// @brief Check the message against the rate limits of the client, before parsing it.
+    /// This only peeks the first tag of the message, so flooding clients cost as little as possible.
+    /// @param field_number Field number of the first field in the message.
+    /// @return Whether the message should be handled; if not, it's counted as dropped.
+    bool admit_message(client_info& client, const SteamNetworkingMessage_t& net_msg, int field_number)
+    {
+        const rate_limited_type type = rate_limited_type_of(field_number);
+        if (type == rate_limited_type::count)
+        {
+            _unknown_type_messages.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        auto& limiter = client.rate_limiters[(std::size_t)type];
+        if (!limiter.messages.try_consume(1, net_msg.m_usecTimeReceived) ||
+            !limiter.bytes.try_consume(net_msg.m_cbSize, net_msg.m_usecTimeReceived))
+        {
+            logger::debug("Dropped a message of {} bytes from client #{}, over the rate limit", net_msg.m_cbSize,
+                          net_msg.m_conn);
+            _rate_limited_messages[(std::size_t)type].fetch_add(1, std::memory_order_relaxed);
+            _rate_limited_bytes[(std::size_t)type].fetch_add(net_msg.m_cbSize, std::memory_order_relaxed);
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Remove the client from the rooms it has joined, and from `clients`.
+    void remove_client(client_handle handle)
+    {
+        client_info* client = _clients.get(handle);
+        if (!client)
+            return;
+
+        for (const auto& room : client->rooms)
+            remove_room_member(room, handle);
+        if (_clients.get_hot_info(handle)->slow)
+            _slow_clients.fetch_sub(1, std::memory_order_relaxed);
+        if (!client->name.empty())
+            _metrics.logged_in_clients.add(-1);
+
+        _clients.erase(handle);
+        _metrics.connected_clients.set((std::int64_t)_clients.size());
+    }
+
+    /// @brief Check how much is waiting to be sent to each client, and apply the slow consumer policy.
+    void check_slow_consumers()
+    {
+        const std::int32_t max_pending_bytes = _settings.slow_consumer_pending_bytes;
+        const auto max_queue_usec =
+            (SteamNetworkingMicroseconds)std::chrono::microseconds(_settings.slow_consumer_queue_time).count();
+
+        const auto conns = _clients.connections();
+        const auto clients = _clients.clients();
+        const auto hot_infos = _clients.hot_infos();
+        for (std::size_t i = 0; i < conns.size(); ++i)
+        {
+            const HSteamNetConnection conn = conns[i];
+            client_info& client = clients[i];
+            bool& slow = hot_infos[i].slow;
+
+            SteamNetConnectionRealTimeStatus_t status;
+            if (_transport.get_connection_real_time_status(conn, status) != k_EResultOK)
+                continue;
+
+            if (!slow)
+            {
+                if (status.m_cbPendingReliable <= max_pending_bytes && status.m_usecQueueTime <= max_queue_usec)
+                    continue;
+
+                if (_settings.slow_consumer == slow_consumer_policy::disconnect)
+                {
+                    _slow_consumers_to_disconnect.push_back(_clients.handle_at(i));
+                    continue;
+                }
+
+                slow = true;
+                _slow_clients.fetch_add(1, std::memory_order_relaxed);
+                logger::warning("Client #{} is a slow consumer: {} bytes pending, {}us queue time", conn,
+                                status.m_cbPendingReliable, status.m_usecQueueTime);
+            }
+            else
+            {
+                // Recover only when it's well below the thresholds, so it doesn't flip back and forth
+                if (status.m_cbPendingReliable > max_pending_bytes / 2 || status.m_usecQueueTime > max_queue_usec / 2)
+                    continue;
+
+                slow = false;
+                _slow_clients.fetch_sub(1, std::memory_order_relaxed);
+                logger::info("Client #{} caught up, {} chats were dropped", conn, client.dropped_chats);
+
+                if (_settings.slow_consumer == slow_consumer_policy::summarize && client.dropped_chats > 0)
+                {
+                    send_server_notice(conn, std::format("{} chats were dropped, as your connection was lagging",
+                                                         client.dropped_chats));
+                }
+                client.dropped_chats = 0;
+            }
+        }
+
+        // Disconnect after the iteration, as it removes from `_clients`
+        for (const auto handle : _slow_consumers_to_disconnect)
+        {
+            const HSteamNetConnection conn = _clients.connection_of(handle);
+            logger::warning("Disconnecting client #{} as a slow consumer", conn);
+
+            remove_client(handle);
+            _transport.close_connection(conn, 0, "Slow consumer", false);
+            if (_capturing)
+                _capture.add_disconnect(conn, _transport.local_timestamp());
+            _disconnected_slow_clients.fetch_add(1, std::memory_order_relaxed);
+            _metrics.disconnects.add();
+        }
+        _slow_consumers_to_disconnect.clear();
+    }
+
+    /// @brief Sample the transport status of the connections due by now, in the current sweep.
+    /// A sweep visits all the clients evenly over `transport_sample_interval`,
+    /// so a pass samples only a few of them instead of stalling on all of them at once.
+    void sample_transport_quality(std::chrono::steady_clock::time_point now)
+    {
+        const auto interval = _settings.transport_sample_interval;
+        if (interval <= interval.zero())
+            return;
+
+        // Where the sweep should be by now
+        const std::size_t client_count = _clients.size();
+        const double progress = std::chrono::duration<double>(now - _transport_sweep_start) / interval;
+        const auto target = (std::size_t)std::min((double)client_count, std::ceil(progress * (double)client_count));
+
+        const auto conns = _clients.connections();
+        for (; _transport_sample_cursor < target; ++_transport_sample_cursor)
+        {
+            const HSteamNetConnection conn = conns[_transport_sample_cursor];
+
+            SteamNetConnectionRealTimeStatus_t status;
+            if (_transport.get_connection_real_time_status(conn, status) == k_EResultOK)
+                _transport_quality.add(conn, status);
+        }
+
+        if (progress >= 1.0 && _transport_sample_cursor >= client_count)
+        {
+            _transport_quality.finish_sweep();
+            _transport_sample_cursor = 0;
+            _transport_sweep_start = now;
+        }
+    }
+
+    /// @brief Whether a chat to this client should be dropped, as it's a slow consumer.
+    /// This counts the dropped chat, too, which is the only time `client` is touched.
+    bool drop_chat_to(const client_hot_info& hot_info, client_info& client)
+    {
+        if (!hot_info.slow)
+            return false;
+
+        ++client.dropped_chats;
+        _dropped_chats.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /// @brief Send the payload to a single client, without copying it.
+    /// @param payload Serialized message to send.
+    /// @param conn Connection to send to.
+    /// @param send_lane Lane to send on.
+    void send(shared_payload& payload, HSteamNetConnection conn, lane send_lane)
+    {
+        SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+        payload.attach(*msg, conn, k_nSteamNetworkingSend_ReliableNoNagle, (std::uint16_t)send_lane);
+
+        _metrics.messages_out.add();
+        _metrics.bytes_out.add(payload.size());
+        _transport.send_messages(1, &msg);
+    }
+
+    /// @brief Submit all the messages in `_outgoing_msgs` with a single `SendMessages()` call.
+    /// GNS takes the ownership of the messages, and releases the payload when it's done with each of them.
+    void send_outgoing_msgs()
+    {
+        if (_outgoing_msgs.empty())
+            return;
+
+        std::uint64_t bytes = 0;
+        for (const auto* msg : _outgoing_msgs)
+            bytes += (std::uint64_t)msg->m_cbSize;
+        _metrics.messages_out.add(_outgoing_msgs.size());
+        _metrics.bytes_out.add(bytes);
+
+        _transport.send_messages((int)_outgoing_msgs.size(), _outgoing_msgs.data());
+    }
+
+    /// @brief Send the payload to all clients except `sender`, without copying it for each one.
+    /// @param payload Serialized message to send.
+    /// @param sender Connection to skip.
+    void broadcast(shared_payload& payload, HSteamNetConnection sender)
+    {
+        _outgoing_msgs.clear();
+        const auto send_lane = (std::uint16_t)chat_lane(payload.size());
+
+        // Iterate the packed arrays of the registry linearly
+        const auto conns = _clients.connections();
+        const auto clients = _clients.clients();
+        const auto hot_infos = _clients.hot_infos();
+        for (std::size_t i = 0; i < conns.size(); ++i)
+        {
+            const auto other_conn = conns[i];
+
+            // Ignore itself, and the slow consumers
+            if (other_conn != sender && !drop_chat_to(hot_infos[i], clients[i]))
+            {
+                // Allocate a message without its own buffer, and point it to the shared payload
+                SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+                payload.attach(*msg, other_conn, k_nSteamNetworkingSend_ReliableNoNagle, send_lane);
+                _outgoing_msgs.push_back(msg);
+            }
+        }
+
+        // Submit them all at once
+        send_outgoing_msgs();
+    }
+
+    /// @brief Send the payload to all members of the room except `sender`, without copying it for each one.
+    /// @param payload Serialized message to send.
+    /// @param room Room to send to.
+    /// @param sender Client to skip.
+    void broadcast_to_room(shared_payload& payload, const room_info& room, client_handle sender)
+    {
+        _outgoing_msgs.clear();
+        const auto send_lane = (std::uint16_t)chat_lane(payload.size());
+
+        for (const auto member : room.members)
+        {
+            // Ignore itself, and the slow consumers
+            if (member == sender || drop_chat_to(*_clients.get_hot_info(member), *_clients.get(member)))
+                continue;
+
+            SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+            payload.attach(*msg, _clients.connection_of(member), k_nSteamNetworkingSend_ReliableNoNagle, send_lane);
+            _outgoing_msgs.push_back(msg);
+        }
+
+        send_outgoing_msgs();
+    }
+
+    /// @brief Queue an encoded `ChatBatch.chats` entry to the recipient's batch.
+    /// @param recipient Recipient client.
+    /// @param entry Encoded entry to append.
+    /// @param received When the chat of the entry was received, to measure its latency if it's sent right away.
+    /// @return Whether the entry is left pending in the batch, to be sent by `flush_batches()`.
+    bool queue_to_batch(client_handle recipient, std::span<const std::byte> entry,
+                        SteamNetworkingMicroseconds received)
+    {
+        client_info* client = _clients.get(recipient);
+        if (!client || drop_chat_to(*_clients.get_hot_info(recipient), *client))
+            return false;
+        auto& pending = client->pending_batch;
+
+        // This is the first chat in this batch period, so start the clock
+        if (_batch_recipients.empty())
+            _batch_deadline = std::chrono::steady_clock::now() + _settings.batch_delay;
+
+        if (!client->in_batch_recipients)
+        {
+            _batch_recipients.push_back(recipient);
+            client->in_batch_recipients = true;
+        }
+        pending.insert(pending.end(), entry.begin(), entry.end());
+
+        // Don't let a batch grow too big, just send it right away
+        if (pending.size() >= MAX_BATCH_BYTES)
+        {
+            _outgoing_msgs.clear();
+            queue_batch_message(_clients.connection_of(recipient), pending);
+            send_outgoing_msgs();
+
+            _metrics.receive_to_send_latency_us.record((std::uint64_t)(_transport.local_timestamp() - received));
+            return false;
+        }
+
+        return true;
+    }
+
+    /// @brief Send all the pending batches, each as a single message to its recipient.
+    void flush_batches()
+    {
+        _outgoing_msgs.clear();
+
+        // A recipient might have left since its chat was queued, which its stale handle tells
+        for (const auto recipient : _batch_recipients)
+        {
+            client_info* client = _clients.get(recipient);
+            if (!client)
+                continue;
+            client->in_batch_recipients = false;
+            if (!client->pending_batch.empty())
+                queue_batch_message(_clients.connection_of(recipient), client->pending_batch);
+        }
+        _batch_recipients.clear();
+
+        send_outgoing_msgs();
+
+        const SteamNetworkingMicroseconds now = _transport.local_timestamp();
+        for (const auto received : _batched_chat_receive_times)
+            _metrics.receive_to_send_latency_us.record((std::uint64_t)(now - received));
+        _batched_chat_receive_times.clear();
+    }
+
+    /// @brief Wrap the pending entries into a `ChatProtocol.chat_batch` message, and queue it to `_outgoing_msgs`.
+    /// The pending entries are cleared, keeping its capacity for the next batch.
+    void queue_batch_message(HSteamNetConnection conn, std::vector<std::byte>& pending)
+    {
+        constexpr int field_number = GNSPrac::Chat::ChatProtocol::kChatBatchFieldNumber;
+
+        const auto batch_size = (std::uint32_t)pending.size();
+        const auto header_size = wire_format::len_header_size(field_number, batch_size);
+
+        shared_payload* payload = shared_payload::create((std::uint32_t)(header_size + batch_size));
+        std::byte* out = wire_format::write_len_header(payload->data(), field_number, batch_size);
+        std::copy(pending.begin(), pending.end(), out);
+        pending.clear();
+
+        SteamNetworkingMessage_t* msg = _transport.allocate_message(0);
+        payload->attach(*msg, conn, k_nSteamNetworkingSend_ReliableNoNagle,
+                        (std::uint16_t)chat_lane(payload->size()));
+        payload->release();
+        _outgoing_msgs.push_back(msg);
+    }
+
+    /// @brief Remove the member from the room, and remove the room itself if it's empty now.
+    void remove_room_member(const std::string& room_name, client_handle member)
+    {
+        auto it = _rooms.find(room_name);
+        if (it == _rooms.end())
+            return;
+
+        auto& members = it->second.members;
+        auto member_it = std::find(members.begin(), members.end(), member);
+        if (member_it != members.end())
+        {
+            // Order of members doesn't matter, so just swap with the last one
+            *member_it = members.back();
+            members.pop_back();
+        }
+
+        if (members.empty())
+            _rooms.erase(it);
+    }
+
+    /// @brief Make a protobuf message on the arena, or on `heap_msg` if the arena is disabled.
+    /// @param heap_msg Storage of the message if it's not on the arena, which must outlive the returned message.
+    template <typename Message>
+    auto make_message(std::optional<Message>& heap_msg) -> Message&
+    {
+        if (_settings.use_protobuf_arena)
+            return *google::protobuf::Arena::CreateMessage<Message>(&_arena);
+        return heap_msg.emplace();
+    }
+
+    /// @brief Send a message from the "Server" to a single client.
+    void send_server_notice(HSteamNetConnection conn, const std::string& content)
+    {
+        std::optional<GNSPrac::Chat::ChatProtocol> heap_response;
+        auto& response = make_message(heap_response);
+        auto& chat = *response.mutable_chat();
+        *chat.mutable_sender_name() = "Server";
+        *chat.mutable_content() = content;
+
+        const std::uint32_t response_size = (std::uint32_t)response.ByteSizeLong();
+        shared_payload* payload = shared_payload::create(response_size);
+        response.SerializeToArray(payload->data(), response_size);
+
+        send(*payload, conn, lane::control);
+        payload->release();
+    }
+
+    /// @brief Validate the wire format of a `ChatProtocol` holding a `chat`, and find the fields of the chat,
+    /// without parsing it.
+    /// @return Whether it's a well-formed chat; if not, or if it's not the usual shape,
+    /// the message should go through the full parse.
+    static bool read_chat(const SteamNetworkingMessage_t& net_msg, chat_view& chat)
+    {
+        using GNSPrac::Chat::Chat;
+
+        // The message should be nothing but a single `ChatProtocol.chat` field
+        wire_format::field_reader msg_reader(net_msg.m_pData, (std::size_t)net_msg.m_cbSize);
+        wire_format::field msg_field;
+        if (!msg_reader.next(msg_field) || msg_field.number != GNSPrac::Chat::ChatProtocol::kChatFieldNumber ||
+            msg_field.wire_type != 2 || msg_reader.next(msg_field) || msg_reader.failed())
+            return false;
+
+        // Find the fields of the chat, the last one winning if repeated, the same as the generated code.
+        // `sender_name` is ignored, as we tell the recipients who sent it.
+        chat = chat_view{};
+        wire_format::field_reader chat_reader(msg_field.bytes.data(), msg_field.bytes.size());
+        wire_format::field chat_field;
+        while (chat_reader.next(chat_field))
+        {
+            const bool is_string = chat_field.number == Chat::kSenderNameFieldNumber ||
+                                   chat_field.number == Chat::kContentFieldNumber ||
+                                   chat_field.number == Chat::kRoomFieldNumber;
+            if (!is_string)
+                continue;
+            if (chat_field.wire_type != 2 || !wire_format::is_valid_utf8(chat_field.bytes))
+                return false;
+
+            if (chat_field.number == Chat::kContentFieldNumber)
+                chat.content = chat_field.bytes;
+            else if (chat_field.number == Chat::kRoomFieldNumber)
+                chat.room = chat_field.bytes;
+        }
+
+        return !chat_reader.failed();
+    }
+
+    /// @brief Relay a chat from the client to the others, or to the other members of the room.
+    /// @param net_msg Received message of the chat.
+    /// @param handle Handle of the sender.
+    /// @param client Sender.
+    /// @param content Content of the chat, which might point into the received message.
+    /// @param room_name Room to send to, or empty to send to everyone.
+    void on_chat(const SteamNetworkingMessage_t& net_msg, client_handle handle, client_info& client,
+                 std::string_view content, std::string_view room_name)
+    {
+        const HSteamNetConnection conn = net_msg.m_conn;
+
+        // Chat to a room is only allowed for its members
+        const room_info* room = nullptr;
+        if (!room_name.empty())
+        {
+            auto room_it = _rooms.find(room_name);
+            if (room_it == _rooms.end() || std::find(client.rooms.begin(), client.rooms.end(), room_name) ==
+                                               client.rooms.end())
+            {
+                send_server_notice(conn, std::format("You're not in the room {}", room_name));
+                return;
+            }
+            room = &room_it->second;
+        }
+
+        // Print the chat message on the server side, too.
+        if (room)
+            logger::info("[{}] {}: {}", room_name, client.display_name, content);
+        else
+            logger::info("{}: {}", client.display_name, content);
+
+        // Encode the response by hand, splicing the sender name encoded in advance,
+        // rather than building another `ChatProtocol` and formatting the name for every chat.
+        const std::uint32_t chat_size = st_chat_server::chat_size(client, content, room_name);
+
+        // With batching enabled, encode it once as a `ChatBatch.chats` entry,
+        // and append it to the batch of each recipient.
+        if (_settings.batch_delay.count() > 0)
+        {
+            const auto header_size =
+                wire_format::len_header_size(GNSPrac::Chat::ChatBatch::kChatsFieldNumber, chat_size);
+            _batch_entry.resize(header_size + chat_size);
+            std::byte* out = wire_format::write_len_header(
+                _batch_entry.data(), GNSPrac::Chat::ChatBatch::kChatsFieldNumber, chat_size);
+            write_chat(out, client, content, room_name);
+
+            // Its latency is measured when the batches are flushed, unless no batch is left holding it
+            const SteamNetworkingMicroseconds received = net_msg.m_usecTimeReceived;
+            bool pending = false;
+            if (room)
+            {
+                for (const auto member : room->members)
+                    if (member != handle)
+                        pending |= queue_to_batch(member, _batch_entry, received);
+            }
+            else
+            {
+                for (std::size_t i = 0; i < _clients.size(); ++i)
+                    if (_clients.handle_at(i) != handle)
+                        pending |= queue_to_batch(_clients.handle_at(i), _batch_entry, received);
+            }
+            if (pending)
+                _batched_chat_receive_times.push_back(received);
+            return;
+        }
+
+        // Encode the response once as a `ChatProtocol.chat`, to a pooled payload shared by all the recipients.
+        const auto header_size =
+            wire_format::len_header_size(GNSPrac::Chat::ChatProtocol::kChatFieldNumber, chat_size);
+        shared_payload* payload = shared_payload::create((std::uint32_t)(header_size + chat_size));
+        std::byte* out = wire_format::write_len_header(payload->data(),
+                                                       GNSPrac::Chat::ChatProtocol::kChatFieldNumber, chat_size);
+        write_chat(out, client, content, room_name);
+
+        // Propagate the response to other clients, or to other members of the room.
+        if (room)
+            broadcast_to_room(*payload, *room, handle);
+        else
+            broadcast(*payload, conn);
+        payload->release();
+
+        _metrics.receive_to_send_latency_us.record(
+            (std::uint64_t)(_transport.local_timestamp() - net_msg.m_usecTimeReceived));
+    }
+
+    /// @brief Callback that's called when a message arrived from any client.
+    void on_message(const SteamNetworkingMessage_t& net_msg)
+    {
+        // Ignore the empty message.
+        // In this case, `netMsg.data` is nullptr
+        if (net_msg.m_cbSize == 0)
+        {
+            logger::warning("Client sent an empty message");
+            return;
+        }
+
+        // Get the client from `clients`, via the handle in the connection user data.
+        // It's added on `ConnectionState::Connecting`, but it might have been removed already,
+        // if we've disconnected it as a slow consumer while its messages were still queued.
+        const client_handle handle = registry_type::from_user_data(net_msg.m_nConnUserData);
+        client_info* client_ptr = _clients.get(handle);
+        if (!client_ptr)
+            return;
+        client_info& client = *client_ptr;
+
+        // Drop the message if the client is sending too much, before spending time on parsing it
+        const int field_number = wire_format::peek_first_field_number(net_msg.m_pData, net_msg.m_cbSize);
+        if (!admit_message(client, net_msg, field_number))
+            return;
+
+        // Fast path of the chats, which relays the content bytes as they are, without parsing the message.
+        // Anything unusual about it is left to the full parse below.
+        if (field_number == GNSPrac::Chat::ChatProtocol::kChatFieldNumber)
+        {
+            chat_view chat;
+            if (read_chat(net_msg, chat))
+            {
+                _relayed_raw_chats.fetch_add(1, std::memory_order_relaxed);
+                on_chat(net_msg, handle, client, chat.content, chat.room);
+                return;
+            }
+        }
+
+        // Unmarshall the protobuf message
+        std::optional<GNSPrac::Chat::ChatProtocol> heap_msg;
+        auto& msg = make_message(heap_msg);
+        if (!msg.ParseFromArray(net_msg.m_pData, net_msg.m_cbSize))
+        {
+            logger::warning("Client sent an invalid message");
+            return;
+        }
+
+        // The rate limit was charged by the first field, but the last field of the oneof wins the parse,
+        // so a message that packs several types would be handled without the limit of its handled type.
+        if ((int)msg.msg_case() != field_number)
+        {
+            logger::warning("Client #{} sent a message of several types", net_msg.m_conn);
+            return;
+        }
+
+        // Handle the message based on its type
+        switch (msg.msg_case())
+        {
+            using msg_case = GNSPrac::Chat::ChatProtocol::MsgCase;
+
+        case msg_case::kChat:
+            on_chat(net_msg, handle, client, msg.chat().content(), msg.chat().room());
+            break;
+
+        case msg_case::kJoinRoom: {
+            const std::string& room_name = msg.join_room().room();
+            if (room_name.empty() || room_name.size() > MAX_ROOM_NAME_LENGTH)
+            {
+                send_server_notice(net_msg.m_conn, "Invalid room name");
+                break;
+            }
+            if (std::find(client.rooms.begin(), client.rooms.end(), room_name) != client.rooms.end())
+            {
+                send_server_notice(net_msg.m_conn, std::format("You're already in the room {}", room_name));
+                break;
+            }
+            if (client.rooms.size() >= MAX_ROOMS_PER_CLIENT)
+            {
+                send_server_notice(net_msg.m_conn,
+                                   std::format("You can't join more than {} rooms", MAX_ROOMS_PER_CLIENT));
+                break;
+            }
+
+            client.rooms.push_back(room_name);
+            _rooms[room_name].members.push_back(handle);
+
+            logger::info("Client #{} joined the room {}", net_msg.m_conn, room_name);
+            send_server_notice(net_msg.m_conn, std::format("You joined the room {}", room_name));
+            break;
+        }
+
+        case msg_case::kLeaveRoom: {
+            const std::string& room_name = msg.leave_room().room();
+            auto room_it = std::find(client.rooms.begin(), client.rooms.end(), room_name);
+            if (room_it == client.rooms.end())
+            {
+                send_server_notice(net_msg.m_conn, std::format("You're not in the room {}", room_name));
+                break;
+            }
+
+            client.rooms.erase(room_it);
+            remove_room_member(room_name, handle);
+
+            logger::info("Client #{} left the room {}", net_msg.m_conn, room_name);
+            send_server_notice(net_msg.m_conn, std::format("You left the room {}", room_name));
+            break;
+        }
+
+        case msg_case::kNameChange: {
+            // Set the new name if not null
+            if (msg.has_name_change() && !msg.name_change().name().empty())
+            {
+                if (client.name.empty())
+                    _metrics.logged_in_clients.add(1);
+                client.name = msg.name_change().name();
+                set_display_name(client, client.name);
+                logger::info("Client #{} changed their name to {}", net_msg.m_conn, client.name);
+            }
+
+            // Notify to the client about their current name
+            send_server_notice(net_msg.m_conn, std::format("Your name is now {}", client.display_name));
+            break;
+        }
+
+        default:
+            // Client shouldn't send other type of messages
+            logger::warning("Client sent an invalid message type: {}", (int)msg.msg_case());
+            break;
+        }
+    }
+};
@@ -0,0 +1,59 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+
+/// @brief Token bucket rate limiter.
+///
+/// Tokens are refilled at `rate_per_second` up to `burst`, and each `try_consume()` takes some of them.
+/// The time is given by the caller, e.g. `SteamNetworkingMessage_t::m_usecTimeReceived`,
+/// so that the hot path doesn't need to read the clock again.
+class token_bucket
+{
+private:
+    double _rate_per_usec = 0;
+    double _burst = 0;
+    double _tokens = 0;
+    SteamNetworkingMicroseconds _last_refill = 0;
+
+public:
+    /// @brief Unlimited bucket, which never runs out of tokens.
+    token_bucket() = default;
+
+    /// @param rate_per_second Tokens refilled per second. Zero means unlimited.
+    /// @param burst Max tokens saved up for a burst. It starts full.
+    token_bucket(double rate_per_second, double burst)
+        : _rate_per_usec(rate_per_second / 1'000'000), _burst(burst), _tokens(burst)
+    {
+    }
+
+    bool unlimited() const
+    {
+        return _rate_per_usec <= 0;
+    }
+
+    /// @brief Take `amount` tokens, if there are enough of them.
+    /// @param amount Tokens to take.
+    /// @param now Current time, in microseconds.
+    /// @return Whether the tokens were taken; if not, the bucket is left as is.
+    bool try_consume(double amount, SteamNetworkingMicroseconds now)
+    {
+        if (unlimited())
+            return true;
+
+        if (now > _last_refill)
+        {
+            _tokens = std::min(_burst, _tokens + (double)(now - _last_refill) * _rate_per_usec);
+            _last_refill = now;
+        }
+
+        if (_tokens < amount)
+            return false;
+
+        _tokens -= amount;
+        return true;
+    }
+};
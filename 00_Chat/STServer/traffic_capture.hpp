@@ -0,0 +1,366 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// @brief Binary capture of the traffic a server received, to replay it later with `chat_replay`.
+///
+/// The file starts with `MAGIC`, followed by the records until the end of the file.
+/// A record is its `record_type` byte, and then these as varints:
+/// the time in microseconds since the capture started, and the connection as the server saw it.
+/// A `record_type::message` is followed by the size of the message as a varint, and its bytes as received.
+///
+/// Only what the clients did is captured: the connections opened & closed by them, and the messages from them.
+/// What the server does in response is up to the server being replayed against.
+namespace traffic_capture
+{
+
+inline constexpr std::array<char, 8> MAGIC{'G', 'N', 'S', 'C', 'A', 'P', '0', '1'};
+
+enum class record_type : std::uint8_t
+{
+    /// @brief A client connected.
+    connect = 1,
+    /// @brief A client closed the connection, it was lost, or the server closed it.
+    disconnect = 2,
+    /// @brief A message received from a client.
+    message = 3,
+};
+
+struct record
+{
+    record_type type;
+    /// @brief Microseconds since the capture started.
+    std::uint64_t time_us;
+    HSteamNetConnection conn;
+    /// @brief Bytes of a `record_type::message`; empty for the others.
+    std::vector<std::byte> data;
+};
+
+/// @brief Appends the records to a capture file, writing the file on its own thread.
+///
+/// The `add_*()` calls only encode the record into a buffer, which is handed to the writer thread
+/// when it's grown large enough, or on `flush()`.
+/// If the writer thread falls too far behind, whole buffers are dropped instead of blocking the caller,
+/// and counted in the stats.
+///
+/// All but `get_stats()` must be called from a single thread, e.g. the server loop.
+class writer
+{
+public:
+    /// @brief The buffer is handed to the writer thread when it grows over this.
+    static constexpr std::size_t HANDOVER_BYTES = 256 * 1024;
+    /// @brief ...or when `flush()` is called this long after the last handover.
+    static constexpr std::chrono::milliseconds FLUSH_INTERVAL{100};
+    /// @brief Buffers are dropped while the writer thread has this many bytes waiting to be written.
+    static constexpr std::size_t MAX_PENDING_BYTES = 64 * 1024 * 1024;
+
+    struct stats
+    {
+        std::uint64_t records;
+        std::uint64_t bytes_written;
+        /// @brief Records dropped, as the writer thread couldn't keep up.
+        std::uint64_t dropped_records;
+    };
+
+private:
+    std::ofstream _file;
+    SteamNetworkingMicroseconds _start_time = 0;
+
+    // Encoded on the caller's thread
+    std::vector<std::byte> _buffer;
+    std::uint64_t _buffer_records = 0;
+    std::chrono::steady_clock::time_point _last_handover;
+
+    // Handed over to the writer thread
+    std::mutex _mutex;
+    std::condition_variable _cv;
+    std::vector<std::byte> _pending;
+    bool _quit_requested = false;
+    std::thread _thread;
+
+    std::atomic<std::uint64_t> _records;
+    std::atomic<std::uint64_t> _bytes_written;
+    std::atomic<std::uint64_t> _dropped_records;
+
+public:
+    writer() = default;
+
+    writer(const writer&) = delete;
+    writer& operator=(const writer&) = delete;
+
+    ~writer()
+    {
+        close();
+    }
+
+public:
+    /// @brief Create the capture file, and start the writer thread.
+    /// Throws `std::runtime_error` if the file can't be created.
+    /// @param start_time Local timestamp the times of the records are relative to.
+    void open(const std::string& path, SteamNetworkingMicroseconds start_time)
+    {
+        close();
+
+        _file.open(path, std::ios::binary | std::ios::trunc);
+        if (!_file)
+            throw std::runtime_error("Failed to create the capture file " + path);
+        _file.write(MAGIC.data(), (std::streamsize)MAGIC.size());
+
+        _start_time = start_time;
+        _buffer.clear();
+        _buffer.reserve(HANDOVER_BYTES + 1024);
+        _buffer_records = 0;
+        _last_handover = std::chrono::steady_clock::now();
+        _quit_requested = false;
+        _records.store(0, std::memory_order_relaxed);
+        _bytes_written.store(MAGIC.size(), std::memory_order_relaxed);
+        _dropped_records.store(0, std::memory_order_relaxed);
+
+        _thread = std::thread(&writer::writer_loop, this);
+    }
+
+    /// @brief Write everything added so far, and close the file.
+    void close()
+    {
+        if (!_thread.joinable())
+            return;
+
+        handover();
+        {
+            std::lock_guard lock(_mutex);
+            _quit_requested = true;
+        }
+        _cv.notify_one();
+        _thread.join();
+
+        _file.close();
+    }
+
+    void add_connect(HSteamNetConnection conn, SteamNetworkingMicroseconds time)
+    {
+        add_header(record_type::connect, conn, time);
+        end_record();
+    }
+
+    void add_disconnect(HSteamNetConnection conn, SteamNetworkingMicroseconds time)
+    {
+        add_header(record_type::disconnect, conn, time);
+        end_record();
+    }
+
+    void add_message(HSteamNetConnection conn, SteamNetworkingMicroseconds time, const void* data, int size)
+    {
+        add_header(record_type::message, conn, time);
+        write_varint((std::uint64_t)std::max(size, 0));
+        if (size > 0)
+        {
+            const auto* bytes = static_cast<const std::byte*>(data);
+            _buffer.insert(_buffer.end(), bytes, bytes + size);
+        }
+        end_record();
+    }
+
+    /// @brief Hand the records added so far to the writer thread, if it's been a while since the last time.
+    /// Call this regularly, so that the file doesn't lag far behind while the traffic is low.
+    void flush()
+    {
+        if (!_buffer.empty() && std::chrono::steady_clock::now() - _last_handover >= FLUSH_INTERVAL)
+            handover();
+    }
+
+    /// @brief This can be called from any thread.
+    auto get_stats() const -> stats
+    {
+        return stats{
+            .records = _records.load(std::memory_order_relaxed),
+            .bytes_written = _bytes_written.load(std::memory_order_relaxed),
+            .dropped_records = _dropped_records.load(std::memory_order_relaxed),
+        };
+    }
+
+private:
+    void add_header(record_type type, HSteamNetConnection conn, SteamNetworkingMicroseconds time)
+    {
+        _buffer.push_back((std::byte)type);
+        write_varint((std::uint64_t)std::max<SteamNetworkingMicroseconds>(time - _start_time, 0));
+        write_varint(conn);
+    }
+
+    void end_record()
+    {
+        ++_buffer_records;
+        if (_buffer.size() >= HANDOVER_BYTES)
+            handover();
+    }
+
+    void write_varint(std::uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            _buffer.push_back((std::byte)(value | 0x80));
+            value >>= 7;
+        }
+        _buffer.push_back((std::byte)value);
+    }
+
+    void handover()
+    {
+        _last_handover = std::chrono::steady_clock::now();
+        if (_buffer.empty())
+            return;
+
+        bool dropped = false;
+        {
+            std::lock_guard lock(_mutex);
+            if (_pending.size() + _buffer.size() > MAX_PENDING_BYTES)
+                dropped = true;
+            else if (_pending.empty())
+                _pending.swap(_buffer);
+            else
+                _pending.insert(_pending.end(), _buffer.begin(), _buffer.end());
+        }
+
+        if (dropped)
+            _dropped_records.fetch_add(_buffer_records, std::memory_order_relaxed);
+        else
+        {
+            _records.fetch_add(_buffer_records, std::memory_order_relaxed);
+            _cv.notify_one();
+        }
+
+        _buffer.clear();
+        _buffer_records = 0;
+    }
+
+    void writer_loop()
+    {
+        std::vector<std::byte> writing;
+
+        std::unique_lock lock(_mutex);
+        while (true)
+        {
+            _cv.wait(lock, [this] { return _quit_requested || !_pending.empty(); });
+            if (_pending.empty())
+                break;
+
+            writing.swap(_pending);
+            lock.unlock();
+
+            _file.write(reinterpret_cast<const char*>(writing.data()), (std::streamsize)writing.size());
+            _bytes_written.fetch_add(writing.size(), std::memory_order_relaxed);
+            writing.clear();
+
+            lock.lock();
+        }
+
+        _file.flush();
+    }
+};
+
+/// @brief Reads the records of a capture file one by one, without loading the whole file.
+class reader
+{
+private:
+    std::ifstream _file;
+    bool _truncated = false;
+
+public:
+    /// @brief Open the capture file.
+    /// Throws `std::runtime_error` if it can't be opened, or it's not a capture file.
+    explicit reader(const std::string& path) : _file(path, std::ios::binary)
+    {
+        if (!_file)
+            throw std::runtime_error("Failed to open the capture file " + path);
+
+        std::array<char, MAGIC.size()> magic{};
+        _file.read(magic.data(), (std::streamsize)magic.size());
+        if (!_file || magic != MAGIC)
+            throw std::runtime_error(path + " is not a capture file");
+    }
+
+    /// @brief Read the next record.
+    /// @return Whether a record was read; false at the end of the file, or at a truncated or corrupted record.
+    bool next(record& out)
+    {
+        const int type = _file.get();
+        if (type == std::char_traits<char>::eof())
+            return false;
+
+        std::uint64_t conn = 0;
+        if (!read_varint(out.time_us) || !read_varint(conn))
+            return truncated();
+        out.type = (record_type)type;
+        out.conn = (HSteamNetConnection)conn;
+        out.data.clear();
+
+        switch (out.type)
+        {
+        case record_type::connect:
+        case record_type::disconnect:
+            return true;
+
+        case record_type::message: {
+            std::uint64_t size = 0;
+            // Nothing bigger than a message can be captured, so a bigger size is a corrupted record
+            if (!read_varint(size) || size > (std::uint64_t)k_cbMaxSteamNetworkingSocketsMessageSizeSend)
+                return truncated();
+            out.data.resize((std::size_t)size);
+            _file.read(reinterpret_cast<char*>(out.data.data()), (std::streamsize)size);
+            if (!_file)
+                return truncated();
+            return true;
+        }
+
+        default:
+            return truncated();
+        }
+    }
+
+    /// @brief Whether the reading stopped at a truncated or corrupted record, e.g. of a server killed while capturing.
+    bool is_truncated() const
+    {
+        return _truncated;
+    }
+
+private:
+    bool truncated()
+    {
+        _truncated = true;
+        return false;
+    }
+
+    bool read_varint(std::uint64_t& out)
+    {
+        out = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            const int byte = _file.get();
+            if (byte == std::char_traits<char>::eof())
+                return false;
+
+            out |= (std::uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+} // namespace traffic_capture
@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "gns_context.hpp"
+
+#include <steam/isteamnetworkingutils.h>
+#include <steam/steamnetworkingsockets.h>
+#include <steam/steamnetworkingtypes.h>
+
+#include <cstdint>
+#include <mutex>
+
+/// @brief Connection, send, receive and poll group calls the server makes, behind an interface.
+///
+/// The server runs on `gns_transport` in production, and on `memory_transport` in the benchmarks,
+/// which measures the server logic without any socket in the way.
+///
+/// The methods mirror `ISteamNetworkingSockets` and `ISteamNetworkingUtils`, and so do their semantics:
+/// the connection status changed callback is taken from the configs of `create_listen_socket_ip()`,
+/// and it's run only within `wait()`.
+class transport
+{
+public:
+    virtual ~transport() = default;
+
+    /// @brief Get ready for use, or share with other users in this process.
+    /// Throws `std::runtime_error` if it failed.
+    virtual void acquire() = 0;
+    virtual void release() = 0;
+
+    /// @brief Prevent the callbacks from running, while the lock is held.
+    [[nodiscard]] virtual auto lock_polling() -> std::unique_lock<std::mutex> = 0;
+
+    /// @brief Wait until there's some activity, or `max_wait_milliseconds` has passed, and run the callbacks.
+    /// See `gns_context::wait()`.
+    virtual void wait(std::uint64_t& seen_wake_seq, int max_wait_milliseconds) = 0;
+
+    /// @brief Wake up all the threads waiting on `wait()`, e.g. to let them see a quit request.
+    /// A thread blocked polling the sockets still returns only when its poll does.
+    virtual void wake() = 0;
+
+    virtual auto local_timestamp() -> SteamNetworkingMicroseconds = 0;
+
+    virtual auto create_listen_socket_ip(const SteamNetworkingIPAddr& addr, int config_count,
+                                         const SteamNetworkingConfigValue_t* configs) -> HSteamListenSocket = 0;
+    virtual bool close_listen_socket(HSteamListenSocket socket) = 0;
+
+    virtual auto create_poll_group() -> HSteamNetPollGroup = 0;
+    virtual bool destroy_poll_group(HSteamNetPollGroup poll_group) = 0;
+
+    virtual auto accept_connection(HSteamNetConnection conn) -> EResult = 0;
+    virtual bool close_connection(HSteamNetConnection conn, int reason, const char* debug, bool linger) = 0;
+    virtual bool set_connection_poll_group(HSteamNetConnection conn, HSteamNetPollGroup poll_group) = 0;
+    virtual bool set_connection_user_data(HSteamNetConnection conn, std::int64_t user_data) = 0;
+    virtual auto configure_connection_lanes(HSteamNetConnection conn, int lane_count, const int* priorities,
+                                            const std::uint16_t* weights) -> EResult = 0;
+    virtual auto get_connection_real_time_status(HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t& status)
+        -> EResult = 0;
+
+    /// @return Number of messages received, or -1 if the poll group is invalid.
+    virtual auto receive_messages_on_poll_group(HSteamNetPollGroup poll_group, SteamNetworkingMessage_t** msgs,
+                                                int max_msgs) -> int = 0;
+
+    /// @brief Allocate a message to send, with a buffer of `size` bytes.
+    /// With zero size, point it to your own buffer, and set `m_pfnFreeData` to free it.
+    virtual auto allocate_message(int size) -> SteamNetworkingMessage_t* = 0;
+
+    /// @brief Send the messages, taking the ownership of them.
+    virtual void send_messages(int msg_count, SteamNetworkingMessage_t* const* msgs) = 0;
+};
+
+/// @brief Transport on the `GameNetworkingSockets`, shared by all the servers in this process via `gns_context`.
+class gns_transport final : public transport
+{
+private:
+    gns_transport() = default;
+
+public:
+    static auto shared() -> gns_transport&
+    {
+        static gns_transport instance;
+        return instance;
+    }
+
+    void acquire() override
+    {
+        gns_context::acquire();
+    }
+
+    void release() override
+    {
+        gns_context::release();
+    }
+
+    auto lock_polling() -> std::unique_lock<std::mutex> override
+    {
+        return gns_context::lock_polling();
+    }
+
+    void wait(std::uint64_t& seen_wake_seq, int max_wait_milliseconds) override
+    {
+        gns_context::wait(seen_wake_seq, max_wait_milliseconds);
+    }
+
+    void wake() override
+    {
+        gns_context::wake_all();
+    }
+
+    auto local_timestamp() -> SteamNetworkingMicroseconds override
+    {
+        return SteamNetworkingUtils()->GetLocalTimestamp();
+    }
+
+    auto create_listen_socket_ip(const SteamNetworkingIPAddr& addr, int config_count,
+                                 const SteamNetworkingConfigValue_t* configs) -> HSteamListenSocket override
+    {
+        return SteamNetworkingSockets()->CreateListenSocketIP(addr, config_count, configs);
+    }
+
+    bool close_listen_socket(HSteamListenSocket socket) override
+    {
+        return SteamNetworkingSockets()->CloseListenSocket(socket);
+    }
+
+    auto create_poll_group() -> HSteamNetPollGroup override
+    {
+        return SteamNetworkingSockets()->CreatePollGroup();
+    }
+
+    bool destroy_poll_group(HSteamNetPollGroup poll_group) override
+    {
+        return SteamNetworkingSockets()->DestroyPollGroup(poll_group);
+    }
+
+    auto accept_connection(HSteamNetConnection conn) -> EResult override
+    {
+        return SteamNetworkingSockets()->AcceptConnection(conn);
+    }
+
+    bool close_connection(HSteamNetConnection conn, int reason, const char* debug, bool linger) override
+    {
+        return SteamNetworkingSockets()->CloseConnection(conn, reason, debug, linger);
+    }
+
+    bool set_connection_poll_group(HSteamNetConnection conn, HSteamNetPollGroup poll_group) override
+    {
+        return SteamNetworkingSockets()->SetConnectionPollGroup(conn, poll_group);
+    }
+
+    bool set_connection_user_data(HSteamNetConnection conn, std::int64_t user_data) override
+    {
+        return SteamNetworkingSockets()->SetConnectionUserData(conn, user_data);
+    }
+
+    auto configure_connection_lanes(HSteamNetConnection conn, int lane_count, const int* priorities,
+                                    const std::uint16_t* weights) -> EResult override
+    {
+        return SteamNetworkingSockets()->ConfigureConnectionLanes(conn, lane_count, priorities, weights);
+    }
+
+    auto get_connection_real_time_status(HSteamNetConnection conn, SteamNetConnectionRealTimeStatus_t& status)
+        -> EResult override
+    {
+        return SteamNetworkingSockets()->GetConnectionRealTimeStatus(conn, &status, 0, nullptr);
+    }
+
+    auto receive_messages_on_poll_group(HSteamNetPollGroup poll_group, SteamNetworkingMessage_t** msgs,
+                                        int max_msgs) -> int override
+    {
+        return SteamNetworkingSockets()->ReceiveMessagesOnPollGroup(poll_group, msgs, max_msgs);
+    }
+
+    auto allocate_message(int size) -> SteamNetworkingMessage_t* override
+    {
+        return SteamNetworkingUtils()->AllocateMessage(size);
+    }
+
+    void send_messages(int msg_count, SteamNetworkingMessage_t* const* msgs) override
+    {
+        SteamNetworkingSockets()->SendMessages(msg_count, msgs, nullptr);
+    }
+};
@@ -0,0 +1,186 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include "metrics.hpp"
+
+#include <steam/steamnetworkingtypes.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/// @brief Aggregates the transport status of many connections into server-wide summaries.
+///
+/// Feed it a `SteamNetConnectionRealTimeStatus_t` of every connection with `add()`, spread over as many calls
+/// as you like, and call `finish_sweep()` when all the connections have been sampled once.
+/// That publishes the percentiles of the sweep and the connections standing out from the rest,
+/// which any thread can read with `get_report()`.
+///
+/// The connection quality is summarized as the packet loss, `1 - quality`, in per mille,
+/// so that the tail percentiles point to the bad links like those of the other values.
+class transport_quality
+{
+public:
+    /// @brief A connection is an outlier if one of its values is over this many times the median...
+    static constexpr std::uint32_t OUTLIER_MEDIAN_FACTOR = 4;
+    /// @brief ...and over the median by at least these.
+    static constexpr std::uint32_t OUTLIER_MIN_PING_EXCESS_MS = 50;
+    static constexpr std::uint32_t OUTLIER_MIN_LOSS_EXCESS_PER_MILLE = 50;
+    static constexpr std::uint32_t OUTLIER_MIN_QUEUE_TIME_EXCESS_US = 100'000;
+
+    /// @brief Outliers reported per sweep, the ones with the highest ping first.
+    static constexpr std::size_t MAX_OUTLIERS = 16;
+
+    /// @brief Transport status of a connection, as sampled.
+    struct sample
+    {
+        HSteamNetConnection conn;
+        std::uint32_t ping_ms;
+        /// @brief Packet loss seen by us, in per mille.
+        std::uint32_t local_loss_per_mille;
+        /// @brief Packet loss seen by the client, in per mille.
+        std::uint32_t remote_loss_per_mille;
+        std::uint32_t send_rate_bytes;
+        std::uint32_t pending_reliable_bytes;
+        std::uint32_t pending_unreliable_bytes;
+        /// @brief How long a message queued now would wait before being sent, in microseconds.
+        std::uint32_t queue_time_us;
+    };
+
+    struct report
+    {
+        /// @brief Sweeps finished so far.
+        std::uint64_t sweeps;
+
+        /// @brief Summaries of the last finished sweep.
+        histogram::summary ping_ms;
+        histogram::summary local_loss_per_mille;
+        histogram::summary remote_loss_per_mille;
+        histogram::summary send_rate_bytes;
+        histogram::summary pending_reliable_bytes;
+        histogram::summary pending_unreliable_bytes;
+        histogram::summary queue_time_us;
+
+        /// @brief Connections of the last finished sweep whose ping, loss or queue time stands out.
+        std::vector<sample> outliers;
+    };
+
+private:
+    // Current sweep
+    std::vector<sample> _samples;
+    histogram _ping_ms;
+    histogram _local_loss_per_mille;
+    histogram _remote_loss_per_mille;
+    histogram _send_rate_bytes;
+    histogram _pending_reliable_bytes;
+    histogram _pending_unreliable_bytes;
+    histogram _queue_time_us;
+
+    // Last finished sweep
+    mutable std::mutex _report_mutex;
+    report _report{};
+
+public:
+    /// @brief Add the status of a connection to the current sweep.
+    void add(HSteamNetConnection conn, const SteamNetConnectionRealTimeStatus_t& status)
+    {
+        const sample s{
+            .conn = conn,
+            .ping_ms = (std::uint32_t)std::max(status.m_nPing, 0),
+            .local_loss_per_mille = loss_per_mille(status.m_flConnectionQualityLocal),
+            .remote_loss_per_mille = loss_per_mille(status.m_flConnectionQualityRemote),
+            .send_rate_bytes = (std::uint32_t)std::max(status.m_nSendRateBytesPerSecond, 0),
+            .pending_reliable_bytes = (std::uint32_t)std::max(status.m_cbPendingReliable, 0),
+            .pending_unreliable_bytes = (std::uint32_t)std::max(status.m_cbPendingUnreliable, 0),
+            .queue_time_us = (std::uint32_t)std::clamp<SteamNetworkingMicroseconds>(status.m_usecQueueTime, 0,
+                                                                                    UINT32_MAX),
+        };
+        _samples.push_back(s);
+
+        _ping_ms.record(s.ping_ms);
+        _local_loss_per_mille.record(s.local_loss_per_mille);
+        _remote_loss_per_mille.record(s.remote_loss_per_mille);
+        _send_rate_bytes.record(s.send_rate_bytes);
+        _pending_reliable_bytes.record(s.pending_reliable_bytes);
+        _pending_unreliable_bytes.record(s.pending_unreliable_bytes);
+        _queue_time_us.record(s.queue_time_us);
+    }
+
+    /// @brief Publish the current sweep, and start a new one.
+    void finish_sweep()
+    {
+        report next{
+            .sweeps = 0,
+            .ping_ms = _ping_ms.get_summary(),
+            .local_loss_per_mille = _local_loss_per_mille.get_summary(),
+            .remote_loss_per_mille = _remote_loss_per_mille.get_summary(),
+            .send_rate_bytes = _send_rate_bytes.get_summary(),
+            .pending_reliable_bytes = _pending_reliable_bytes.get_summary(),
+            .pending_unreliable_bytes = _pending_unreliable_bytes.get_summary(),
+            .queue_time_us = _queue_time_us.get_summary(),
+            .outliers = {},
+        };
+
+        for (const auto& s : _samples)
+        {
+            if (is_outlier(s.ping_ms, next.ping_ms.p50, OUTLIER_MIN_PING_EXCESS_MS) ||
+                is_outlier(s.local_loss_per_mille, next.local_loss_per_mille.p50, OUTLIER_MIN_LOSS_EXCESS_PER_MILLE) ||
+                is_outlier(s.queue_time_us, next.queue_time_us.p50, OUTLIER_MIN_QUEUE_TIME_EXCESS_US))
+                next.outliers.push_back(s);
+        }
+
+        const std::size_t outlier_count = std::min(next.outliers.size(), MAX_OUTLIERS);
+        std::partial_sort(next.outliers.begin(), next.outliers.begin() + outlier_count, next.outliers.end(),
+                          [](const sample& a, const sample& b) { return a.ping_ms > b.ping_ms; });
+        next.outliers.resize(outlier_count);
+
+        {
+            std::lock_guard lock(_report_mutex);
+            next.sweeps = _report.sweeps + 1;
+            _report = std::move(next);
+        }
+
+        clear_sweep();
+    }
+
+    /// @brief Get the summaries of the last finished sweep.
+    /// This can be called from any thread.
+    auto get_report() const -> report
+    {
+        std::lock_guard lock(_report_mutex);
+        return _report;
+    }
+
+    void reset()
+    {
+        clear_sweep();
+
+        std::lock_guard lock(_report_mutex);
+        _report = report{};
+    }
+
+private:
+    void clear_sweep()
+    {
+        _samples.clear();
+        for (histogram* h : {&_ping_ms, &_local_loss_per_mille, &_remote_loss_per_mille, &_send_rate_bytes,
+                             &_pending_reliable_bytes, &_pending_unreliable_bytes, &_queue_time_us})
+            h->reset();
+    }
+
+    /// @param quality Fraction of the packets delivered, or negative if unknown yet.
+    static auto loss_per_mille(float quality) -> std::uint32_t
+    {
+        if (quality < 0)
+            return 0;
+        return (std::uint32_t)((1.0f - std::min(quality, 1.0f)) * 1000.0f + 0.5f);
+    }
+
+    static bool is_outlier(std::uint64_t value, std::uint64_t median, std::uint64_t min_excess)
+    {
+        return value > std::max(median * OUTLIER_MEDIAN_FACTOR, median + min_excess);
+    }
+};
@@ -0,0 +1,231 @@
+// SPDX-License-Identifier: 0BSD
+
+#pragma once
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+/// @brief Helpers to write the protobuf wire format by hand.
+/// This is for splicing already encoded bytes into a message, without re-encoding them with the generated code.
+namespace wire_format
+{
+
+/// @brief Largest field number protobuf allows, `2^29 - 1`; 0 isn't a valid field number either.
+constexpr int MAX_FIELD_NUMBER = (1 << 29) - 1;
+
+/// @brief Tag of a length-delimited field (string, bytes, or embedded message).
+constexpr auto len_tag(int field_number) -> std::uint32_t
+{
+    return ((std::uint32_t)field_number << 3) | 2;
+}
+
+/// @brief Size of the tag & length prefix of a length-delimited field.
+inline auto len_header_size(int field_number, std::uint32_t content_size) -> std::size_t
+{
+    using google::protobuf::io::CodedOutputStream;
+
+    return CodedOutputStream::VarintSize32(len_tag(field_number)) + CodedOutputStream::VarintSize32(content_size);
+}
+
+/// @brief Write the tag & length prefix of a length-delimited field.
+/// The caller writes `content_size` bytes of the content right after it.
+/// @return Pointer past the written prefix.
+inline auto write_len_header(std::byte* out, int field_number, std::uint32_t content_size) -> std::byte*
+{
+    using google::protobuf::io::CodedOutputStream;
+
+    auto* target = reinterpret_cast<std::uint8_t*>(out);
+    target = CodedOutputStream::WriteVarint32ToArray(len_tag(field_number), target);
+    target = CodedOutputStream::WriteVarint32ToArray(content_size, target);
+    return reinterpret_cast<std::byte*>(target);
+}
+
+/// @brief Size of a length-delimited field, including its content.
+inline auto len_field_size(int field_number, std::string_view content) -> std::size_t
+{
+    return len_header_size(field_number, (std::uint32_t)content.size()) + content.size();
+}
+
+/// @brief Write a length-delimited field, including its content.
+/// @return Pointer past the written field.
+inline auto write_len_field(std::byte* out, int field_number, std::string_view content) -> std::byte*
+{
+    out = write_len_header(out, field_number, (std::uint32_t)content.size());
+    std::memcpy(out, content.data(), content.size());
+    return out + content.size();
+}
+
+/// @brief Read the field number of the first field in an encoded message, without parsing the message.
+/// For a message with a single `oneof` like `ChatProtocol`, this tells which one it is.
+/// @return The field number, or 0 if it doesn't start with a valid tag.
+inline auto peek_first_field_number(const void* data, int size) -> int
+{
+    const auto* bytes = static_cast<const std::uint8_t*>(data);
+
+    // Tag is a varint of `(field_number << 3) | wire_type`, up to 5 bytes
+    std::uint32_t tag = 0;
+    for (int i = 0; i < std::min(size, 5); ++i)
+    {
+        tag |= (std::uint32_t)(bytes[i] & 0x7F) << (7 * i);
+        if ((bytes[i] & 0x80) == 0)
+            return (int)(tag >> 3);
+    }
+    return 0;
+}
+
+/// @brief A field read by `field_reader`.
+struct field
+{
+    int number;
+    int wire_type;
+    /// @brief Value of a varint field.
+    std::uint64_t varint;
+    /// @brief Content of a length-delimited field, or the bytes of a fixed-size field.
+    /// This points into the message being read.
+    std::string_view bytes;
+};
+
+/// @brief Reads the fields of an encoded message one by one, validating the wire format without parsing it.
+/// Groups are not supported, and treated as malformed.
+class field_reader
+{
+private:
+    const std::uint8_t* _pos;
+    const std::uint8_t* _end;
+    bool _failed = false;
+
+public:
+    field_reader(const void* data, std::size_t size)
+        : _pos(static_cast<const std::uint8_t*>(data)), _end(_pos + size)
+    {
+    }
+
+    /// @brief Read the next field.
+    /// @return Whether a field was read; if not, it's either the end of the message or `failed()`.
+    bool next(field& out)
+    {
+        if (_pos == _end)
+            return false;
+
+        std::uint64_t tag;
+        if (!read_varint(tag) || (tag >> 3) == 0 || (tag >> 3) > MAX_FIELD_NUMBER)
+            return fail();
+
+        out.number = (int)(tag >> 3);
+        out.wire_type = (int)(tag & 7);
+        out.varint = 0;
+        out.bytes = {};
+
+        switch (out.wire_type)
+        {
+        case 0:
+            return read_varint(out.varint) || fail();
+        case 1:
+            return read_bytes(8, out.bytes) || fail();
+        case 2: {
+            std::uint64_t size;
+            return (read_varint(size) && read_bytes(size, out.bytes)) || fail();
+        }
+        case 5:
+            return read_bytes(4, out.bytes) || fail();
+        default:
+            return fail();
+        }
+    }
+
+    /// @brief Whether the message turned out to be malformed.
+    bool failed() const
+    {
+        return _failed;
+    }
+
+private:
+    bool fail()
+    {
+        _failed = true;
+        _pos = _end;
+        return false;
+    }
+
+    bool read_varint(std::uint64_t& out)
+    {
+        out = 0;
+        for (int shift = 0; shift < 64 && _pos != _end; shift += 7)
+        {
+            const std::uint8_t byte = *_pos++;
+            out |= (std::uint64_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool read_bytes(std::uint64_t size, std::string_view& out)
+    {
+        if (size > (std::uint64_t)(_end - _pos))
+            return false;
+
+        out = std::string_view(reinterpret_cast<const char*>(_pos), (std::size_t)size);
+        _pos += size;
+        return true;
+    }
+};
+
+/// @brief Whether the bytes are valid UTF-8, which protobuf requires of a proto3 `string` field.
+/// Overlong encodings, surrogates, and code points over U+10FFFF are rejected.
+inline bool is_valid_utf8(std::string_view str)
+{
+    const auto* pos = reinterpret_cast<const std::uint8_t*>(str.data());
+    const auto* const end = pos + str.size();
+
+    while (pos != end)
+    {
+        const std::uint8_t lead = *pos;
+        if (lead < 0x80)
+        {
+            ++pos;
+            continue;
+        }
+
+        // Number of continuation bytes, and the lower & upper bounds of the second byte
+        int continuations;
+        std::uint8_t second_min = 0x80, second_max = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+            continuations = 1;
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            continuations = 2;
+            if (lead == 0xE0)
+                second_min = 0xA0; // overlong
+            else if (lead == 0xED)
+                second_max = 0x9F; // surrogates
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            continuations = 3;
+            if (lead == 0xF0)
+                second_min = 0x90; // overlong
+            else if (lead == 0xF4)
+                second_max = 0x8F; // over U+10FFFF
+        }
+        else
+            return false;
+
+        if (end - pos <= continuations || pos[1] < second_min || pos[1] > second_max)
+            return false;
+        for (int i = 2; i <= continuations; ++i)
+            if ((pos[i] & 0xC0) != 0x80)
+                return false;
+
+        pos += continuations + 1;
+    }
+
+    return true;
+}
+
+} // namespace wire_format